@@ -54,6 +54,7 @@ void gui_loop();
 void gui_display_6502_error(enum RUN6502_STOP_REASON reason);
 void gui_display_message(int is_error, const char *err_str);
 int gui_ask_question(const char *prompt);
+int gui_build_popup();
 gui_surface_t *gui_surface_create(int width, int height);
 gui_surface_t *gui_surface_from_file(const char *file);
 unsigned char *gui_surface_capture_data(gui_surface_t *surface, int *out_stride);
@@ -63,14 +64,13 @@ void gui_surface_overlay(gui_surface_t *draw, int dest_x, int dest_y);
 void gui_surface_destroy(gui_surface_t *surface);
 void gui_update_for_generators();
 void gui_refesh_for_level();
-void gui_6502_timeout_start();
-void gui_6052_timeout_end();
 void gui_overlay_select_index(int index);
 const char *gui_make_image_path(const struct NoDice_tileset *tileset, const struct NoDice_the_levels *level);
 void gui_set_subtitle(const char *subtitle);
 void gui_set_modepage(enum EDIT_NOTEBOOK_PAGES page);
 void gui_disable_empty_objs(int is_empty);
 void gui_reboot();
+void gui_PRG_refreshed();
 
 extern struct _gui_tilehints
 {
@@ -81,15 +81,18 @@ extern struct _gui_tilehints
 // Edit stuff
 void edit_do();
 void edit_transform_sel_gen(int diff_row, int diff_col);
-void edit_6502_timeout();
 void edit_level_load(unsigned char tileset, const struct NoDice_the_levels *level);
 int edit_level_save(int save_layout, int save_objects);
+int edit_level_save_all();
+int edit_dirty_count();
 void edit_level_save_new_check(const char *tileset_path, const char *layoutfile, int *save_layout, const char *objectfile, int *save_objects);
 int edit_level_add_labels(const struct NoDice_the_levels *level, int add_layout, int add_objects);
 const struct NoDice_the_levels *edit_level_find(unsigned char tileset_id, unsigned short layout_addr, unsigned short objects_addr);
 void edit_gen_remove(struct NoDice_the_level_generator *remove);
 void edit_gen_translate(struct NoDice_the_level_generator *gen, int diff_row, int diff_col);
 void edit_revert();
+void edit_undo();
+void edit_redo();
 void edit_gen_bring_forward(struct NoDice_the_level_generator *gen);
 void edit_gen_send_backward(struct NoDice_the_level_generator *gen);
 void edit_gen_send_to_back(struct NoDice_the_level_generator *gen);
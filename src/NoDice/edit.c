@@ -6,8 +6,6 @@
 #include "NoDiceLib.h"
 #include "NoDice.h"
 
-#define UNDO_STACK_LIMIT	100	// FIXME: User-configurable!
-
 enum UNDOMODE
 {
 	UNDOMODE_GENS_NOHEADER,		// Mark generator undo, headerless
@@ -202,14 +200,213 @@ static const char *edit_level_save_make_option_string(int header_index)
 }
 
 
-int edit_level_save(int save_layout, int save_objects)
+#define EDIT_FILES_MAX	8	// Most files a level saves to (world map: layout, 5 object files, links)
+
+// A file generated for a level, not yet written
+struct edit_file
+{
+	char path[PATH_MAX];
+	struct NoDice_emit emit;
+};
+
+// The open level's files, as generated by edit_level_emit
+static struct edit_file edit_files[EDIT_FILES_MAX];
+static int edit_file_count = 0;
+
+// Levels edited but not saved yet when another was opened; they're all
+// written together by edit_level_save_all, or before any build (which
+// could move what their addresses point at)
+static struct edit_dirty
+{
+	unsigned char tileset;
+	const struct NoDice_the_levels *level;
+
+	struct edit_file files[EDIT_FILES_MAX];
+	int file_count;
+
+	// To put the level back as it was if it's opened again
+	unsigned char *layout;		// Packed, with header (not world maps)
+	int layout_size;
+	unsigned char *map_tiles;	// Tile memory (world maps only)
+	int map_tiles_size;
+	unsigned char object_unknown;
+	struct NoDice_the_level_object objects[OBJS_MAX];
+	int object_count;
+	struct NoDice_map_link map_links[MAX_MAP_LINKS];
+	int map_link_count;
+	unsigned char map_object_items[MOBJS_MAX];
+
+	struct edit_dirty *next;
+} *edit_dirty_levels = NULL;
+
+// Whether the open level loaded properly (and so is worth keeping)
+static int edit_cur_level_loaded = 0;
+
+// Where the open level is in its undo history, counting from where it
+// was loaded: each change is one ahead, each undo one back.  It has
+// unsaved edits unless it's back where it was last saved (-1 if that
+// can't be got back to, e.g. the level came off the dirty list)
+static int edit_history_pos = 0, edit_saved_pos = 0;
+
+// Files the save in progress has actually written (others were already
+// up to date), one per line
+static char edit_saved_files[1024];
+
+
+static void edit_files_free(struct edit_file *files, int *count)
+{
+	int i;
+
+	for(i = 0; i < *count; i++)
+		NoDice_emit_free(&files[i].emit);
+
+	*count = 0;
+}
+
+
+// Takes the file just generated at path_buffer
+static int edit_level_emit_file(struct NoDice_emit *emit)
+{
+	struct edit_file *file = &edit_files[edit_file_count++];
+
+	strcpy(file->path, path_buffer);
+	file->emit = *emit;
+
+	return 1;
+}
+
+
+// Writes out the files (each is released as it's written); returns 0 if
+// any failed, in which case it and the rest are kept, moved down to the
+// start of files, for another try
+static int edit_files_commit(struct edit_file *files, int *count)
+{
+	int i, kept;
+
+	for(i = 0; i < *count; i++)
+	{
+		enum NoDice_emit_result result = NoDice_emit_commit(&files[i].emit, files[i].path);
+
+		if(result == EMIT_FAILED)
+		{
+			gui_display_message(1, NoDice_Error());
+
+			// Output that ran out of memory was released; no use retrying it
+			if(files[i].emit.failed)
+				i++;
+
+			for(kept = 0; i < *count; i++)
+				files[kept++] = files[i];
+
+			*count = kept;
+			return 0;
+		}
+
+		if(result == EMIT_WRITTEN)
+		{
+			int len = strlen(edit_saved_files);
+			snprintf(&edit_saved_files[len], sizeof(edit_saved_files) - len, "\n%s", files[i].path);
+		}
+	}
+
+	*count = 0;
+	return 1;
+}
+
+
+static void edit_dirty_free(struct edit_dirty *dirty)
+{
+	edit_files_free(dirty->files, &dirty->file_count);
+	free(dirty->layout);
+	free(dirty->map_tiles);
+	free(dirty);
+}
+
+
+// Drops the files on the dirty list which these newer ones replace
+static void edit_dirty_supersede(const struct edit_file *files, int count)
+{
+	struct edit_dirty *dirty;
+	int i, j, kept;
+
+	for(dirty = edit_dirty_levels; dirty != NULL; dirty = dirty->next)
+	{
+		for(i = 0, kept = 0; i < dirty->file_count; i++)
+		{
+			for(j = 0; j < count; j++)
+			{
+				if(!strcmp(dirty->files[i].path, files[j].path))
+					break;
+			}
+
+			if(j < count)
+				NoDice_emit_free(&dirty->files[i].emit);
+			else
+				dirty->files[kept++] = dirty->files[i];
+		}
+
+		dirty->file_count = kept;
+	}
+}
+
+
+// Writes every level kept by edit_level_stash; returns 0 on failure,
+// with the levels not yet written still kept
+static int edit_dirty_commit()
+{
+	while(edit_dirty_levels != NULL)
+	{
+		struct edit_dirty *dirty = edit_dirty_levels;
+
+		if(!edit_files_commit(dirty->files, &dirty->file_count))
+			return 0;
+
+		edit_dirty_levels = dirty->next;
+		edit_dirty_free(dirty);
+	}
+
+	return 1;
+}
+
+
+// Number of levels edited but not saved, besides the open one; that's
+// every level on the dirty list, including any whose files have all been
+// taken over by another level's, as its edits are still only kept there
+int edit_dirty_count()
+{
+	struct edit_dirty *dirty;
+	int count = 0;
+
+	for(dirty = edit_dirty_levels; dirty != NULL; dirty = dirty->next)
+		count++;
+
+	return count;
+}
+
+
+static void edit_level_save_message(const char *message)
+{
+	char message_buf[sizeof(edit_saved_files) + 128];
+
+	if(edit_saved_files[0] != '\0')
+		snprintf(message_buf, sizeof(message_buf), "%s\n\nFiles written:%s", message, edit_saved_files);
+	else
+		snprintf(message_buf, sizeof(message_buf), "%s\n\nNo files changed.", message);
+
+	gui_display_message(0, message_buf);
+}
+
+
+// Generates the open level's files into edit_files
+static int edit_level_emit(int save_layout, int save_objects)
 {
 	const char *autogen_warning = "; WARNING: Autogenerated file!  Do not put extra data here; editor will not preserve it!\n";
-	const char *build_err;
 	const struct NoDice_the_levels *level_alternate;
 	const unsigned char *level_data;
 	int i, size, col = 0;
-	FILE *asm_file;
+	struct NoDice_emit emit;
+
+	edit_files_free(edit_files, &edit_file_count);
 
 	if(NoDice_the_level.tileset->id > 0)
 	{
@@ -220,24 +417,15 @@ int edit_level_save(int save_layout, int save_objects)
 			// the asm file belonging to the level itself...
 			snprintf(path_buffer, PATH_MAX, SUBDIR_LEVELS "/%s/%s" EXT_ASM, NoDice_the_level.tileset->path, edit_cur_level->layoutfile);
 
-			asm_file = fopen(path_buffer, "w");
-
-			if(!asm_file)
-			{
-				char error_buf[512];
-
-				snprintf(error_buf, sizeof(error_buf), "edit_level_save: Failed to write %s: %s", path_buffer, strerror(errno));
-				gui_display_message(1, error_buf);
-				return 0;
-			}
+			NoDice_emit_begin(&emit);
 
-			fputs(autogen_warning, asm_file);
+			NoDice_emit_str(&emit, autogen_warning);
 
 			level_alternate = edit_level_find(NoDice_the_level.header.alt_level_tileset, NoDice_the_level.header.alt_level_layout, NoDice_the_level.header.alt_level_objects);
 			if(level_alternate != NULL)
 			{
 				// Found the alternate!  Use labels (preferred!)
-				fprintf(asm_file,
+				NoDice_emit_printf(&emit,
 						"\t.word %s\t; Alternate level layout\n"
 						"\t.word %s\t; Alternate object layout\n",
 
@@ -248,7 +436,7 @@ int edit_level_save(int save_layout, int save_objects)
 			else
 			{
 				// Didn't find it, use addresses (not flexible!)
-				fprintf(asm_file,
+				NoDice_emit_printf(&emit,
 						"\t.word $%04X\t; Alternate level layout\n"
 						"\t.word $%04X\t; Alternate object layout\n",
 
@@ -262,12 +450,13 @@ int edit_level_save(int save_layout, int save_objects)
 			{
 				const char *next_header = edit_level_save_make_option_string(i);
 				if(next_header != NULL)
-					fprintf(asm_file, "\t.byte %s\n", next_header);
+					NoDice_emit_printf(&emit, "\t.byte %s\n", next_header);
 				else
 				{
 					// This really should NEVER happen!!
 					gui_display_message(1, "INTERNAL ERROR: A generated header line was too long!");
-					fclose(asm_file);
+					NoDice_emit_free(&emit);
+					edit_files_free(edit_files, &edit_file_count);
 					return 0;
 				}
 			}
@@ -275,21 +464,31 @@ int edit_level_save(int save_layout, int save_objects)
 			// Pack the level
 			level_data = NoDice_pack_level(&size, 0);
 
-			// Write it out, byte-for-byte, 16 bytes per row
-			for(i = 0; i < size; i++)
+			if(!NoDice_config.game.options.layout_incbin)
 			{
-				if(col == 0)
-					fprintf(asm_file, "\n\t.byte ");
+				// Write it out, byte-for-byte, 16 bytes per row
+				NoDice_emit_byte_rows(&emit, level_data, size, &col);
 
-				fprintf(asm_file, "$%02X", level_data[i]);
-
-				if(++col == 16)
-					col = 0;
-				else if(i < (size-1))
-					fprintf(asm_file, ", ");
+				if(!edit_level_emit_file(&emit))
+					return 0;
 			}
+			else
+			{
+				// The header stays readable, but the layout itself goes in
+				// a file of its own which the assembler takes as it is
+				NoDice_emit_printf(&emit, "\n\t.incbin \"" SUBDIR_LEVELS "/%s/%s" EXT_LAYOUT_BIN "\"\n", NoDice_the_level.tileset->path, edit_cur_level->layoutfile);
 
-			fclose(asm_file);
+				if(!edit_level_emit_file(&emit))
+					return 0;
+
+				snprintf(path_buffer, PATH_MAX, SUBDIR_LEVELS "/%s/%s" EXT_LAYOUT_BIN, NoDice_the_level.tileset->path, edit_cur_level->layoutfile);
+
+				NoDice_emit_begin(&emit);
+				NoDice_emit_bytes(&emit, level_data, size);
+
+				if(!edit_level_emit_file(&emit))
+					return 0;
+			}
 		}
 
 
@@ -299,39 +498,35 @@ int edit_level_save(int save_layout, int save_objects)
 			// Also need to rewrite the object file
 			snprintf(path_buffer, PATH_MAX, SUBDIR_OBJECTS "/%s" EXT_ASM, edit_cur_level->objectfile);
 
-			asm_file = fopen(path_buffer, "w");
-
-			if(!asm_file)
-			{
-				char error_buf[512];
-
-				snprintf(error_buf, sizeof(error_buf), "edit_level_save: Failed to write %s: %s", path_buffer, strerror(errno));
-				gui_display_message(1, error_buf);
-				return 0;
-			}
+			NoDice_emit_begin(&emit);
 
-			fputs(autogen_warning, asm_file);
+			NoDice_emit_str(&emit, autogen_warning);
 
-			fprintf(asm_file, "\t.byte $%02X\t; Unknown purpose\n\n", NoDice_the_level.object_unknown);
+			NoDice_emit_printf(&emit, "\t.byte $%02X\t; Unknown purpose\n\n", NoDice_the_level.object_unknown);
 
 			for(i = 0; i < NoDice_the_level.object_count; i++)
 			{
 				const struct NoDice_the_level_object *obj = &NoDice_the_level.objects[i];
 				const char *label = NoDice_config.game.regular_objects[obj->id].label;
-				fputs("\t.byte ", asm_file);
+				NoDice_emit_str(&emit, "\t.byte ");
 
 				// Label expansion
 				if(label != NULL)
-					fprintf(asm_file, "%s, ", label);
+					NoDice_emit_str(&emit, label);
 				else
-					fprintf(asm_file, "$%02X, ", obj->id);	// Fallback to raw ID
+					NoDice_emit_hex8(&emit, obj->id);	// Fallback to raw ID
 
-				fprintf(asm_file, "$%02X, $%02X\n", obj->col, obj->row);
+				NoDice_emit_str(&emit, ", ");
+				NoDice_emit_hex8(&emit, obj->col);
+				NoDice_emit_str(&emit, ", ");
+				NoDice_emit_hex8(&emit, obj->row);
+				NoDice_emit_str(&emit, "\n");
 			}
 
-			fputs("\t.byte $FF\n", asm_file);
+			NoDice_emit_str(&emit, "\t.byte $FF\n");
 
-			fclose(asm_file);
+			if(!edit_level_emit_file(&emit))
+				return 0;
 		}
 	}
 	else
@@ -356,45 +551,26 @@ int edit_level_save(int save_layout, int save_objects)
 		////////////////////////////////////////////////////////////////////
 		snprintf(path_buffer, PATH_MAX, SUBDIR_MAPS "/%sL" EXT_ASM, edit_cur_level->layoutfile);
 
-		asm_file = fopen(path_buffer, "w");
+		NoDice_emit_begin(&emit);
 
-		if(!asm_file)
-		{
-			char error_buf[512];
-
-			snprintf(error_buf, sizeof(error_buf), "edit_level_save: Failed to write %s: %s", path_buffer, strerror(errno));
-			gui_display_message(1, error_buf);
-			return 0;
-		}
-
-		fputs(autogen_warning, asm_file);
+		NoDice_emit_str(&emit, autogen_warning);
 
 		for(screen = 0; screen < NoDice_the_level.header.total_screens; screen++)
 		{
 			int screen_offset = (SCREEN_BYTESIZE * screen) + (SCREEN_MAP_ROW_OFFSET * TILESIZE);
 
 			// Write it out, byte-for-byte, 16 bytes per row
-			for(i = 0; i < SCREEN_BYTESIZE_M; i++)
-			{
-				if(col == 0)
-					fprintf(asm_file, "\n\t.byte ");
-
-				fprintf(asm_file, "$%02X", NoDice_the_level.tiles[screen_offset + i]);
-
-				if(++col == 16)
-					col = 0;
-				else if(i < (SCREEN_BYTESIZE_M-1))
-					fprintf(asm_file, ", ");
-			}
+			NoDice_emit_byte_rows(&emit, &NoDice_the_level.tiles[screen_offset], SCREEN_BYTESIZE_M, &col);
 
 			// spacer
-			fputc('\n', asm_file);
+			NoDice_emit_str(&emit, "\n");
 		}
 
 		// Terminator
-		fputs("\n\t.byte $FF\n", asm_file);
+		NoDice_emit_str(&emit, "\n\t.byte $FF\n");
 
-		fclose(asm_file);
+		if(!edit_level_emit_file(&emit))
+			return 0;
 
 
 		////////////////////////////////////////////////////////////////////
@@ -408,20 +584,11 @@ int edit_level_save(int save_layout, int save_objects)
 
 				snprintf(path_buffer, PATH_MAX, SUBDIR_MAPS "/%s%s" EXT_ASM, edit_cur_level->objectfile, objfiles[i]);
 
-				asm_file = fopen(path_buffer, "w");
+				NoDice_emit_begin(&emit);
 
-				if(!asm_file)
-				{
-					char error_buf[512];
+				NoDice_emit_str(&emit, autogen_warning);
 
-					snprintf(error_buf, sizeof(error_buf), "edit_level_save: Failed to write %s: %s", path_buffer, strerror(errno));
-					gui_display_message(1, error_buf);
-					return 0;
-				}
-
-				fputs(autogen_warning, asm_file);
-
-				fputs("\t.byte ", asm_file);
+				NoDice_emit_str(&emit, "\t.byte ");
 
 				for(j = 0; j < MOBJS_MAX; j++)
 				{
@@ -441,16 +608,17 @@ int edit_level_save(int save_layout, int save_objects)
 						next_byte = ((object->row + MAP_OBJECT_BASE_ROW) * TILESIZE);
 
 					if((i != OF_ID) || NoDice_config.game.map_objects[next_byte].label == NULL)
-						fprintf(asm_file, "$%02X", next_byte);
+						NoDice_emit_hex8(&emit, next_byte);
 					else
 						// Object ID label expansion
-						fprintf(asm_file, "%s", NoDice_config.game.map_objects[next_byte].label);
+						NoDice_emit_printf(&emit, "%s", NoDice_config.game.map_objects[next_byte].label);
 
 					if(j < (MOBJS_MAX-1))
-						fputs(", ", asm_file);
+						NoDice_emit_str(&emit, ", ");
 				}
 
-				fclose(asm_file);
+				if(!edit_level_emit_file(&emit))
+					return 0;
 			}
 		}
 
@@ -460,30 +628,21 @@ int edit_level_save(int save_layout, int save_objects)
 		////////////////////////////////////////////////////////////////////
 		snprintf(path_buffer, PATH_MAX, SUBDIR_MAPS "/%sS" EXT_ASM, edit_cur_level->layoutfile);
 
-		asm_file = fopen(path_buffer, "w");
-
-		if(!asm_file)
-		{
-			char error_buf[512];
-
-			snprintf(error_buf, sizeof(error_buf), "edit_level_save: Failed to write %s: %s", path_buffer, strerror(errno));
-			gui_display_message(1, error_buf);
-			return 0;
-		}
+		NoDice_emit_begin(&emit);
 
-		fputs(autogen_warning, asm_file);
+		NoDice_emit_str(&emit, autogen_warning);
 
 
 		// Store lookup index labels
-		fprintf(asm_file, "W%s_InitIndex:\t.byte $00, ", edit_cur_level->layoutlabel);
+		NoDice_emit_printf(&emit, "W%s_InitIndex:\t.byte $00, ", edit_cur_level->layoutlabel);
 		for(i = 2; i <= 4; i++)
 		{
-			fprintf(asm_file, "(W%s_ByRowType_S%i - W%s_ByRowType)", edit_cur_level->layoutlabel, i, edit_cur_level->layoutlabel);
+			NoDice_emit_printf(&emit, "(W%s_ByRowType_S%i - W%s_ByRowType)", edit_cur_level->layoutlabel, i, edit_cur_level->layoutlabel);
 
 			if(i < 4)
-				fputs(", ", asm_file);
+				NoDice_emit_str(&emit, ", ");
 		}
-		fputc('\n', asm_file);
+		NoDice_emit_str(&emit, "\n");
 
 
 		// Begin storing screens
@@ -510,7 +669,7 @@ int edit_level_save(int save_layout, int save_objects)
 					const char *data_type = ((col == LBL_BYROWTYPE) || (col == LBL_BYSCRCOL)) ? "byte" : "word";
 
 					// Print label
-					fprintf(asm_file, "W%s_%s:\t.%s ", edit_cur_level->layoutlabel, labels[col], data_type);
+					NoDice_emit_printf(&emit, "W%s_%s:\t.%s ", edit_cur_level->layoutlabel, labels[col], data_type);
 
 					for(i = 0; i < NoDice_the_level.map_link_count; i++)
 					{
@@ -520,16 +679,16 @@ int edit_level_save(int save_layout, int save_objects)
 						// Insert new labels on screen-change
 						if(screen != this_screen)
 						{
-							fprintf(asm_file, "\nW%s_%s_S%i:\t.%s ", edit_cur_level->layoutlabel, labels[col], this_screen + 1, data_type);
+							NoDice_emit_printf(&emit, "\nW%s_%s_S%i:\t.%s ", edit_cur_level->layoutlabel, labels[col], this_screen + 1, data_type);
 							screen = this_screen;
 						}
 						else if(i > 0)
-							fputs(", ", asm_file);
+							NoDice_emit_str(&emit, ", ");
 
 						if(col == LBL_BYROWTYPE)
-							fprintf(asm_file, "$%02X", link->row_tileset);
+							NoDice_emit_hex8(&emit, link->row_tileset);
 						else if(col == LBL_BYSCRCOL)
-							fprintf(asm_file, "$%02X", link->col_hi);
+							NoDice_emit_hex8(&emit, link->col_hi);
 						else if( (col == LBL_OBJSETS) || (col == LBL_LEVELLAYOUT) )
 						{
 							// Non-warp zone...
@@ -564,65 +723,140 @@ int edit_level_save(int save_layout, int save_objects)
 							{
 								if(level != NULL)
 									// Layout label is always printed
-									fprintf(asm_file, "%s", level->layoutlabel);
+									NoDice_emit_printf(&emit, "%s", level->layoutlabel);
 								else
-									fprintf(asm_file, "$%04X", link->layout_addr);
+									NoDice_emit_printf(&emit, "$%04X", link->layout_addr);
 							}
 							else
 							{
 								// Object label is printed only if not special
 								if(!is_special && level != NULL)
-									fprintf(asm_file, "%s", level->objectlabel);
+									NoDice_emit_printf(&emit, "%s", level->objectlabel);
 								else
-									fprintf(asm_file, "$%04X", link->object_addr);
+									NoDice_emit_printf(&emit, "$%04X", link->object_addr);
 							}
 						}
 
 					}
 
-					fputc('\n', asm_file);
+					NoDice_emit_str(&emit, "\n");
 				}
 				else
 				{
 					// Warp zone writes nothing for object sets / layouts
-					fprintf(asm_file, "W%s_%s:\n", edit_cur_level->layoutlabel, labels[col]);
+					NoDice_emit_printf(&emit, "W%s_%s:\n", edit_cur_level->layoutlabel, labels[col]);
 					screen = 0;
 				}
 
 				// Write out missing labels, if any
 				for(screen++ ; screen < 4; screen++)
-					fprintf(asm_file, "W%s_%s_S%i:\n", edit_cur_level->layoutlabel, labels[col], screen + 1);
+					NoDice_emit_printf(&emit, "W%s_%s_S%i:\n", edit_cur_level->layoutlabel, labels[col], screen + 1);
 
 				// Begin storing screens
 				screen = 0;
 			}
 		}
 
-		fclose(asm_file);
+		if(!edit_level_emit_file(&emit))
+			return 0;
 	}
 
 
 
-	// Now ... initiate the build!!
-	build_err = NoDice_DoBuild();
+	return 1;
+}
 
-	if(build_err != NULL)
-	{
-		gui_display_message(1, build_err);
+
+static int edit_level_build()
+{
+	// Levels kept for later go in with this build, as it may move what
+	// their addresses point at
+	if(!edit_dirty_commit())
+		return 0;
+
+	// Now ... initiate the build!!  The popup shows the output, and
+	// keeps it up if the build fails
+	if(!gui_build_popup())
 		return 0;
-	}
 	else
 	{
 		if(!NoDice_PRG_refresh())
 			gui_display_message(0, NoDice_Error());
 		else
-			gui_display_message(0, "Save and build complete!");
+		{
+			gui_PRG_refreshed();
+			edit_level_save_message("Save and build complete!");
+		}
 	}
 
 	return 1;
 }
 
 
+int edit_level_save(int save_layout, int save_objects)
+{
+	edit_saved_files[0] = '\0';
+
+	if(!edit_level_emit(save_layout, save_objects))
+		return 0;
+
+	edit_dirty_supersede(edit_files, edit_file_count);
+
+	if(!edit_files_commit(edit_files, &edit_file_count))
+		return 0;
+
+	edit_saved_pos = edit_history_pos;
+
+	// Every file was already up to date, and so is the ROM built from them
+	if(edit_saved_files[0] == '\0' && !NoDice_build_needed())
+	{
+		edit_level_save_message("Save complete!  (Nothing changed; the ROM is up to date)");
+		return 1;
+	}
+
+	// If the level packs to the same size as what the ROM has, it can be
+	// patched straight in; the assembler can wait for a save that needs
+	// it (and the patch is checked against what it builds then)
+	if(NoDice_the_level.tileset->id > 0 && NoDice_fast_apply_level(edit_cur_level, save_layout, save_objects))
+	{
+		gui_PRG_refreshed();
+		edit_level_save_message("Save complete!  (Patched into the ROM; assembled with the next full build)");
+		return 1;
+	}
+
+	return edit_level_build();
+}
+
+
+// Saves the open level and every other level edited since the last
+// build, then assembles once
+int edit_level_save_all()
+{
+	edit_saved_files[0] = '\0';
+
+	if(!edit_level_emit(TRUE, TRUE))
+		return 0;
+
+	edit_dirty_supersede(edit_files, edit_file_count);
+
+	if(!edit_files_commit(edit_files, &edit_file_count))
+		return 0;
+
+	edit_saved_pos = edit_history_pos;
+
+	if(!edit_dirty_commit())
+		return 0;
+
+	if(edit_saved_files[0] == '\0' && !NoDice_build_needed())
+	{
+		edit_level_save_message("Save complete!  (Nothing changed; the ROM is up to date)");
+		return 1;
+	}
+
+	return edit_level_build();
+}
+
+
 void edit_level_save_new_check(const char *tileset_path, const char *layoutfile, int *save_layout, const char *objectfile, int *save_objects)
 {
 	struct stat unused;
@@ -734,174 +968,420 @@ static unsigned char *map_tile_calc_ptr(int row, int col)
 }
 
 
-static struct edit_undo
+// An undo (or redo) history; each entry is the state of one part of the
+// level (as selected by its undo_mode) from before the change it undoes.
+// Only the newest entry of each mode holds the whole state; older ones
+// hold just how they differ from the next newer one of the same mode,
+// since most edits only touch a small part of the level.
+static struct edit_history
 {
-	unsigned char *layout_data;
-	int layout_data_size;
-	enum UNDOMODE undo_mode;
-} undo_stack[UNDO_STACK_LIMIT];
-static int
-	undo_stack_pos = 0, 	// Position within stack
-	undo_stack_bottom = 0,	// Current bottom of stack; moves circularly as needed
-	undo_stack_total = 0;	// Total items in undo stack
+	struct edit_undo
+	{
+		enum UNDOMODE undo_mode;
+		unsigned char *data;	// The state, or if is_delta, a struct edit_delta
+		int data_size;
+		int is_delta;
+		struct edit_undo *older, *newer;
+	} *oldest, *newest;
+} undo_history, redo_history;
+
+// An older state as the span of bytes where it differs from a newer one
+struct edit_delta
+{
+	int prefix;		// Bytes the same at the start
+	int suffix;		// Bytes the same at the end
+	// Followed by the bytes between
+};
 
+static unsigned long undo_history_bytes = 0;	// Used by both histories together
 
-// Add copy of level to undo buffer
-static void undo_mark(enum UNDOMODE undo_mode)
+
+// Returns the state captured for undo_mode, allocated; for map tiles,
+// it's the tile at the same spot as in ref
+static unsigned char *undo_capture(enum UNDOMODE undo_mode, const unsigned char *ref, int *size)
 {
-	struct edit_undo *undo = &undo_stack[undo_stack_pos];
-	const unsigned char *layout_data;
+	unsigned char *data;
+
+	if(undo_mode == UNDOMODE_OBJECTS)
+	{
+		int i;
+
+		*size = 3 * NoDice_the_level.object_count;
+		data = (unsigned char *)malloc(sizeof(unsigned char) * (*size > 0 ? *size : 1));
 
-	// If undo stack is maxed out, we move the bottom up
-	if(undo_stack_total == UNDO_STACK_LIMIT)
+		for(i = 0; i < NoDice_the_level.object_count; i++)
+		{
+			const struct NoDice_the_level_object *obj = &NoDice_the_level.objects[i];
+			data[(i * 3) + 0] = obj->row;
+			data[(i * 3) + 1] = obj->col;
+			data[(i * 3) + 2] = obj->id;
+		}
+	}
+	else if(undo_mode == UNDOMODE_MAPTILE)
 	{
-		// Free components from old bottom
-		free(undo_stack[undo_stack_bottom].layout_data);
+		struct NoDice_the_level_object *map_tile = (struct NoDice_the_level_object *)malloc(sizeof(struct NoDice_the_level_object));
+
+		memcpy(map_tile, ref, sizeof(struct NoDice_the_level_object));
+		map_tile->id = *map_tile_calc_ptr(map_tile->row, map_tile->col);
 
-		undo_stack_bottom = (undo_stack_bottom + 1) % UNDO_STACK_LIMIT;
+		*size = sizeof(struct NoDice_the_level_object);
+		data = (unsigned char *)map_tile;
+	}
+	else if(undo_mode == UNDOMODE_LINK)
+	{
+		*size = sizeof(struct NoDice_map_link) * NoDice_the_level.map_link_count;
+		data = (unsigned char *)malloc(*size > 0 ? *size : 1);
+
+		memcpy(data, NoDice_the_level.map_links, *size);
 	}
 	else
-		undo_stack_total++;
+	{
+		int has_header = (undo_mode == UNDOMODE_GENS_WITHHEADER);
 
-	// Advance position in the undo stack
-	undo_stack_pos = (undo_stack_pos + 1) % UNDO_STACK_LIMIT;
+		// Copy layout data (optional header)
+		const unsigned char *layout_data = NoDice_pack_level(size, has_header);
 
+		data = (unsigned char *)malloc(sizeof(unsigned char) * (*size));
+		memcpy(data, layout_data, *size);
+	}
+
+	return data;
+}
+
+
+// Puts back a state captured by undo_capture
+static void undo_apply(enum UNDOMODE undo_mode, const unsigned char *data, int size)
+{
 	if(undo_mode == UNDOMODE_OBJECTS)
 	{
 		int i;
 
-		undo->layout_data_size = 3 * NoDice_the_level.object_count;
-		undo->layout_data = (unsigned char *)malloc(sizeof(unsigned char) * undo->layout_data_size);
+		// Set back to object mode
+		gui_set_modepage((NoDice_the_level.tileset->id > 0) ? ENPAGE_OBJS : ENPAGE_MOBJS);
+
+		NoDice_the_level.object_count = size / 3;
 
 		for(i = 0; i < NoDice_the_level.object_count; i++)
 		{
-			const struct NoDice_the_level_object *obj = &NoDice_the_level.objects[i];
-			undo->layout_data[(i * 3) + 0] = obj->row;
-			undo->layout_data[(i * 3) + 1] = obj->col;
-			undo->layout_data[(i * 3) + 2] = obj->id;
+			struct NoDice_the_level_object *obj = &NoDice_the_level.objects[i];
+			obj->row = data[(i * 3) + 0];
+			obj->col = data[(i * 3) + 1];
+			obj->id  = data[(i * 3) + 2];
 		}
+
+		gui_update_for_generators();
 	}
 	else if(undo_mode == UNDOMODE_MAPTILE)
 	{
-		// Work is done in a special function
+		const struct NoDice_the_level_object *map_tile = (const struct NoDice_the_level_object *)data;
+		unsigned char *edit_tile = map_tile_calc_ptr(map_tile->row, map_tile->col);
+
+		// Restore tile
+		*edit_tile = map_tile->id;
+
+		// Set back to map tile mode
+		gui_set_modepage(ENPAGE_TILES);
 	}
 	else if(undo_mode == UNDOMODE_LINK)
 	{
-		undo->layout_data_size = sizeof(struct NoDice_map_link) * NoDice_the_level.map_link_count;
-		undo->layout_data = malloc(undo->layout_data_size);
+		// Set back to link mode
+		gui_set_modepage(ENPAGE_LINKS);
 
-		memcpy(undo->layout_data, NoDice_the_level.map_links, undo->layout_data_size);
+		NoDice_the_level.map_link_count = size / sizeof(struct NoDice_map_link);
+		memcpy(NoDice_the_level.map_links, data, size);
+
+		gui_update_for_generators();
 	}
 	else
 	{
-		int has_header = (undo_mode == UNDOMODE_GENS_WITHHEADER);
+		int has_header = undo_mode == UNDOMODE_GENS_WITHHEADER;
+
+		// Set back to generator mode
+		gui_set_modepage(ENPAGE_GENS);
 
-		// Copy layout data onto stack (optional header)
-		layout_data = NoDice_pack_level(&undo->layout_data_size, has_header);
+		// Going to reload based on undo stack!
+		NoDice_load_level_raw_data(data, size, has_header);
 
-		// Allocate and copy data
-		undo->layout_data = (unsigned char *)malloc(sizeof(unsigned char) * undo->layout_data_size);
-		memcpy(undo->layout_data, layout_data, undo->layout_data_size);
+		// If undo changed header, have to reset the virtual PPU
+		if(has_header)
+			ppu_configure_for_level();
 	}
+}
 
-	undo->undo_mode = undo_mode;
+
+// Replaces the state in undo with how it differs from newer_data, if
+// that's smaller
+static void undo_delta_encode(struct edit_undo *undo, const unsigned char *newer_data, int newer_size)
+{
+	struct edit_delta delta;
+	unsigned char *data;
+	int shorter = (undo->data_size < newer_size) ? undo->data_size : newer_size, middle;
+
+	for(delta.prefix = 0; delta.prefix < shorter && undo->data[delta.prefix] == newer_data[delta.prefix]; delta.prefix++)
+		;
+
+	for(delta.suffix = 0; delta.suffix < shorter - delta.prefix &&
+		undo->data[undo->data_size - 1 - delta.suffix] == newer_data[newer_size - 1 - delta.suffix]; delta.suffix++)
+		;
+
+	middle = undo->data_size - delta.prefix - delta.suffix;
+
+	if((int)sizeof(struct edit_delta) + middle >= undo->data_size || (data = (unsigned char *)malloc(sizeof(struct edit_delta) + middle)) == NULL)
+		return;
+
+	memcpy(data, &delta, sizeof(struct edit_delta));
+	memcpy(&data[sizeof(struct edit_delta)], &undo->data[delta.prefix], middle);
+
+	undo_history_bytes -= undo->data_size;
+
+	free(undo->data);
+	undo->data = data;
+	undo->data_size = sizeof(struct edit_delta) + middle;
+	undo->is_delta = 1;
+
+	undo_history_bytes += undo->data_size;
 }
 
 
-static void undo_mark_map_tile(int row, int col, unsigned char tile)
+// Makes the state in undo whole again, from the newer one it was encoded against
+static void undo_delta_decode(struct edit_undo *undo, const unsigned char *newer_data, int newer_size)
 {
-	struct edit_undo *undo = &undo_stack[undo_stack_pos];
-	struct NoDice_the_level_object *map_tile = (struct NoDice_the_level_object *)malloc(sizeof(struct NoDice_the_level_object));
+	struct edit_delta delta;
+	unsigned char *data;
+	int middle = undo->data_size - sizeof(struct edit_delta), size;
 
-	map_tile->row = row;
-	map_tile->col = col;
-	map_tile->id = tile;
+	memcpy(&delta, undo->data, sizeof(struct edit_delta));
+	size = delta.prefix + middle + delta.suffix;
 
-	undo->layout_data_size = sizeof(struct NoDice_the_level_object);
-	undo->layout_data = (unsigned char *)map_tile;
+	data = (unsigned char *)malloc(size > 0 ? size : 1);
+	memcpy(data, newer_data, delta.prefix);
+	memcpy(&data[delta.prefix], &undo->data[sizeof(struct edit_delta)], middle);
+	memcpy(&data[delta.prefix + middle], &newer_data[newer_size - delta.suffix], delta.suffix);
 
-	undo_mark(UNDOMODE_MAPTILE);
+	undo_history_bytes -= undo->data_size;
+
+	free(undo->data);
+	undo->data = data;
+	undo->data_size = size;
+	undo->is_delta = 0;
+
+	undo_history_bytes += undo->data_size;
 }
 
-// Pop an action and revert the change
-static void undo_revert()
+
+// Newest entry of undo_mode older than from (inclusive), if any
+static struct edit_undo *undo_find_mode(struct edit_undo *from, enum UNDOMODE undo_mode)
 {
-	// Make sure we're not at the bottom of the stack already
-	if(undo_stack_total > 0)
+	for( ; from != NULL; from = from->older)
 	{
-		struct edit_undo *undo;
+		if(from->undo_mode == undo_mode)
+			return from;
+	}
 
-		// Reverse position in the undo stack
-		undo_stack_pos = (undo_stack_pos == 0) ? (UNDO_STACK_LIMIT - 1) : (undo_stack_pos - 1);
+	return NULL;
+}
 
-		// One less total
-		undo_stack_total--;
 
-		// Get this action...
-		undo = &undo_stack[undo_stack_pos];
+static void undo_drop(struct edit_history *history, struct edit_undo *undo)
+{
+	if(undo->older != NULL)
+		undo->older->newer = undo->newer;
+	else
+		history->oldest = undo->newer;
 
-		if(undo->undo_mode == UNDOMODE_OBJECTS)
-		{
-			int i;
+	if(undo->newer != NULL)
+		undo->newer->older = undo->older;
+	else
+		history->newest = undo->older;
 
-			// Set back to object mode
-			gui_set_modepage((NoDice_the_level.tileset->id > 0) ? ENPAGE_OBJS : ENPAGE_MOBJS);
+	undo_history_bytes -= sizeof(struct edit_undo) + undo->data_size;
 
-			NoDice_the_level.object_count = undo->layout_data_size / 3;
+	free(undo->data);
+	free(undo);
+}
 
-			for(i = 0; i < NoDice_the_level.object_count; i++)
-			{
-				struct NoDice_the_level_object *obj = &NoDice_the_level.objects[i];
-				obj->row = undo->layout_data[(i * 3) + 0];
-				obj->col = undo->layout_data[(i * 3) + 1];
-				obj->id  = undo->layout_data[(i * 3) + 2];
-			}
 
-			gui_update_for_generators();
-		}
-		else if(undo->undo_mode == UNDOMODE_MAPTILE)
-		{
-			struct NoDice_the_level_object *map_tile = (struct NoDice_the_level_object *)undo->layout_data;
-			unsigned char *edit_tile = map_tile_calc_ptr(map_tile->row, map_tile->col);
+static void undo_clear(struct edit_history *history)
+{
+	while(history->oldest != NULL)
+		undo_drop(history, history->oldest);
+}
 
-			// Restore tile
-			*edit_tile = map_tile->id;
 
-			// Set back to map tile mode
-			gui_set_modepage(ENPAGE_TILES);
-		}
-		else if(undo->undo_mode == UNDOMODE_LINK)
-		{
-			// Set back to link mode
-			gui_set_modepage(ENPAGE_LINKS);
+// Drops the oldest entry which has a newer one of the same mode (so no
+// entry depends on it, and no part of the level loses its last undo;
+// edit_startspot_alt_revert counts on both of its marks being there);
+// returns 0 if there isn't one
+static int undo_drop_oldest(struct edit_history *history)
+{
+	struct edit_undo *undo, *oldest = NULL;
+	unsigned int seen_modes = 0;
 
-			NoDice_the_level.map_link_count = undo->layout_data_size / sizeof(struct NoDice_map_link);
-			memcpy(NoDice_the_level.map_links, undo->layout_data, undo->layout_data_size);
+	for(undo = history->newest; undo != NULL; undo = undo->older)
+	{
+		if(seen_modes & (1 << undo->undo_mode))
+			oldest = undo;
 
-			gui_update_for_generators();
-		}
-		else
-		{
-			int has_header = undo->undo_mode == UNDOMODE_GENS_WITHHEADER;
+		seen_modes |= 1 << undo->undo_mode;
+	}
 
-			// Set back to generator mode
-			gui_set_modepage(ENPAGE_GENS);
+	if(oldest == NULL)
+		return 0;
 
-			// Going to reload based on undo stack!
-			NoDice_load_level_raw_data(undo->layout_data, undo->layout_data_size, has_header);
+	undo_drop(history, oldest);
 
-			// If undo changed header, have to reset the virtual PPU
-			if(has_header)
-				ppu_configure_for_level();
-		}
+	return 1;
+}
+
+
+// Adds a state to the history (which takes over data); the oldest
+// entries go once both histories are over the budget, though never the
+// newest of each mode (see undo_drop_oldest)
+static void undo_push(struct edit_history *history, enum UNDOMODE undo_mode, unsigned char *data, int data_size)
+{
+	struct edit_undo *undo = (struct edit_undo *)calloc(1, sizeof(struct edit_undo)), *previous;
+
+	if(undo == NULL)
+	{
+		free(data);
+		return;
+	}
+
+	// Map tile entries are too small to be worth it
+	if(undo_mode != UNDOMODE_MAPTILE && (previous = undo_find_mode(history->newest, undo_mode)) != NULL)
+		undo_delta_encode(previous, data, data_size);
+
+	undo->undo_mode = undo_mode;
+	undo->data = data;
+	undo->data_size = data_size;
+
+	if( (undo->older = history->newest) != NULL)
+		history->newest->newer = undo;
+	else
+		history->oldest = undo;
+
+	history->newest = undo;
+
+	undo_history_bytes += sizeof(struct edit_undo) + data_size;
+
+	while(undo_history_bytes > NoDice_config.undo_budget)
+	{
+		if(!undo_drop_oldest(&undo_history) && !undo_drop_oldest(&redo_history))
+			break;
+	}
+}
+
+
+// Takes the newest state off the history (which the caller must free);
+// returns NULL if there isn't one
+static unsigned char *undo_pop(struct edit_history *history, enum UNDOMODE *undo_mode, int *data_size)
+{
+	struct edit_undo *undo = history->newest, *previous;
+	unsigned char *data;
+
+	if(undo == NULL)
+		return NULL;
+
+	// The next older one of its mode was relative to this one
+	if( (previous = undo_find_mode(undo->older, undo->undo_mode)) != NULL && previous->is_delta)
+		undo_delta_decode(previous, undo->data, undo->data_size);
+
+	if( (history->newest = undo->older) != NULL)
+		history->newest->newer = NULL;
+	else
+		history->oldest = NULL;
+
+	undo_history_bytes -= sizeof(struct edit_undo) + undo->data_size;
+
+	*undo_mode = undo->undo_mode;
+	*data_size = undo->data_size;
+	data = undo->data;
+
+	free(undo);
+
+	return data;
+}
+
+
+// Counts a new change (see edit_history_pos); if the saved state was
+// ahead in the redo history, it's gone with it
+static void undo_advance()
+{
+	if(edit_saved_pos > edit_history_pos)
+		edit_saved_pos = -1;
+
+	edit_history_pos++;
+}
+
+
+// Add copy of level to undo buffer; a new change means there's nothing to redo
+static void undo_mark(enum UNDOMODE undo_mode)
+{
+	int size;
+	unsigned char *data = undo_capture(undo_mode, NULL, &size);
+
+	undo_clear(&redo_history);
+	undo_push(&undo_history, undo_mode, data, size);
+
+	undo_advance();
+}
+
+
+static void undo_mark_map_tile(int row, int col, unsigned char tile)
+{
+	struct NoDice_the_level_object *map_tile = (struct NoDice_the_level_object *)malloc(sizeof(struct NoDice_the_level_object));
+
+	map_tile->row = row;
+	map_tile->col = col;
+	map_tile->id = tile;
+
+	undo_clear(&redo_history);
+	undo_push(&undo_history, UNDOMODE_MAPTILE, (unsigned char *)map_tile, sizeof(struct NoDice_the_level_object));
+
+	undo_advance();
+}
+
+
+// Pop an action and revert the change (it's gone for good; see undo_step
+// for one which can be redone)
+static void undo_revert()
+{
+	enum UNDOMODE undo_mode;
+	int size;
+	unsigned char *data = undo_pop(&undo_history, &undo_mode, &size);
+
+	if(data != NULL)
+	{
+		undo_apply(undo_mode, data, size);
+		free(data);
 
-		// Free the memory used by this undo
-		if(undo->undo_mode != UNDOMODE_MAPTILE)
-			free(undo->layout_data);
+		edit_history_pos--;
 	}
 }
 
 
+// Takes the newest state off one history and puts it in place, saving
+// what it replaces on the other (undo to redo, or the other way around);
+// returns 0 if there was nothing to take
+static int undo_step(struct edit_history *from, struct edit_history *to)
+{
+	enum UNDOMODE undo_mode;
+	int size, current_size;
+	unsigned char *data = undo_pop(from, &undo_mode, &size), *current;
+
+	if(data != NULL)
+	{
+		current = undo_capture(undo_mode, data, &current_size);
+		undo_push(to, undo_mode, current, current_size);
+
+		undo_apply(undo_mode, data, size);
+		free(data);
+	}
+
+	return data != NULL;
+}
+
+
 // Remove specified generator from list (NOTE: Does not free it!!)
 static void level_gen_remove(struct NoDice_the_level_generator *remove)
 {
@@ -975,63 +1455,163 @@ static int level_gen_count()
 }
 
 
+// Keeps the open level's edits (if it has any) on the dirty list, so
+// opening another doesn't lose them
+static void edit_level_stash()
+{
+	struct edit_dirty *dirty;
+	int i;
+
+	if(!edit_level_emit(TRUE, TRUE))
+		return;
+
+	if( (dirty = (struct edit_dirty *)calloc(1, sizeof(struct edit_dirty))) == NULL)
+	{
+		edit_files_free(edit_files, &edit_file_count);
+		return;
+	}
+
+	// Only the files that differ from what's saved are kept; a file shared
+	// with another level (e.g. a reused object set) isn't otherwise
+	// written back as it was before that level's changes
+	for(i = 0; i < edit_file_count; i++)
+	{
+		if(NoDice_emit_matches(&edit_files[i].emit, edit_files[i].path))
+			NoDice_emit_free(&edit_files[i].emit);
+		else
+			dirty->files[dirty->file_count++] = edit_files[i];
+	}
+
+	edit_file_count = 0;
+
+	// Nothing different from what's saved
+	if(dirty->file_count == 0)
+	{
+		free(dirty);
+		return;
+	}
+
+	edit_dirty_supersede(dirty->files, dirty->file_count);
+
+	dirty->tileset = NoDice_the_level.tileset->id;
+	dirty->level = edit_cur_level;
+
+	if(NoDice_the_level.tileset->id > 0)
+	{
+		const unsigned char *layout = NoDice_pack_level(&dirty->layout_size, 1);
+
+		if( (dirty->layout = (unsigned char *)malloc(dirty->layout_size)) != NULL)
+			memcpy(dirty->layout, layout, dirty->layout_size);
+	}
+	else
+	{
+		dirty->map_tiles_size = SCREEN_BYTESIZE * NoDice_the_level.header.total_screens;
+
+		if( (dirty->map_tiles = (unsigned char *)malloc(dirty->map_tiles_size)) != NULL)
+			memcpy(dirty->map_tiles, NoDice_the_level.tiles, dirty->map_tiles_size);
+	}
+
+	dirty->object_unknown = NoDice_the_level.object_unknown;
+	memcpy(dirty->objects, NoDice_the_level.objects, sizeof(dirty->objects));
+	dirty->object_count = NoDice_the_level.object_count;
+	memcpy(dirty->map_links, NoDice_the_level.map_links, sizeof(dirty->map_links));
+	dirty->map_link_count = NoDice_the_level.map_link_count;
+	memcpy(dirty->map_object_items, NoDice_the_level.map_object_items, sizeof(dirty->map_object_items));
+
+	// No memory to keep it; write it out now, so it goes in with the next build
+	if(dirty->layout == NULL && dirty->map_tiles == NULL)
+	{
+		edit_files_commit(dirty->files, &dirty->file_count);
+		edit_dirty_free(dirty);
+		return;
+	}
+
+	dirty->next = edit_dirty_levels;
+	edit_dirty_levels = dirty;
+}
+
+
+// If the just loaded level has edits on the dirty list, puts them back
+// (no build has happened since, so the addresses they hold still apply);
+// returns 1 if it did
+static int edit_level_unstash(unsigned char tileset, const struct NoDice_the_levels *level)
+{
+	struct edit_dirty **link, *dirty;
+
+	for(link = &edit_dirty_levels; *link != NULL; link = &(*link)->next)
+	{
+		if((*link)->tileset == tileset && (*link)->level == level)
+			break;
+	}
+
+	if( (dirty = *link) == NULL)
+		return 0;
+
+	if(dirty->layout != NULL)
+		NoDice_load_level_raw_data(dirty->layout, dirty->layout_size, TRUE);
+	else
+		memcpy(NoDice_the_level.tiles, dirty->map_tiles, dirty->map_tiles_size);
+
+	if(NoDice_Run6502_Stop != RUN6502_STOP_END)
+		return 0;
+
+	NoDice_the_level.object_unknown = dirty->object_unknown;
+	memcpy(NoDice_the_level.objects, dirty->objects, sizeof(dirty->objects));
+	NoDice_the_level.object_count = dirty->object_count;
+	memcpy(NoDice_the_level.map_links, dirty->map_links, sizeof(dirty->map_links));
+	NoDice_the_level.map_link_count = dirty->map_link_count;
+	memcpy(NoDice_the_level.map_object_items, dirty->map_object_items, sizeof(dirty->map_object_items));
+
+	// It's back in the editor, and gets stashed again if left with changes
+	*link = dirty->next;
+	edit_dirty_free(dirty);
+
+	return 1;
+}
+
+
 void edit_level_load(unsigned char tileset, const struct NoDice_the_levels *level)
 {
+	int unstashed = 0;
+
+	// Only if it has changes since it was loaded or saved; if the files
+	// it would write match what's there anyway, it's let go then
+	if(edit_cur_level != NULL && edit_cur_level_loaded && level != edit_cur_level && edit_history_pos != edit_saved_pos)
+		edit_level_stash();
+
 	// Remember level we're looking at
 	edit_cur_level = level;
 
-	// For best accuracy, this must come immediately before the level reload!
-	gui_6502_timeout_start();
-
 	// Load level
 	NoDice_load_level(tileset, level->layoutlabel, level->objectlabel);
 	NoDice_the_level.level = level;
 
-	// Cleanup timer
-	gui_6052_timeout_end();
+	if(NoDice_Run6502_Stop == RUN6502_STOP_END)
+		unstashed = edit_level_unstash(tileset, level);
+
+	edit_cur_level_loaded = (NoDice_Run6502_Stop == RUN6502_STOP_END);
 
 	// If an error occurred, display it!
 	if(NoDice_Run6502_Stop != RUN6502_STOP_END)
 		gui_display_6502_error(NoDice_Run6502_Stop);
 
-	// Unwind the undo stack
-	while(undo_stack_total > 0)
-	{
-		struct edit_undo *undo;
+	// History is for the level that was open
+	undo_clear(&undo_history);
+	undo_clear(&redo_history);
 
-		// Reverse position in the undo stack
-		undo_stack_pos = (undo_stack_pos == 0) ? (UNDO_STACK_LIMIT - 1) : (undo_stack_pos - 1);
-
-		// One less total
-		undo_stack_total--;
-
-		// Get this action...
-		undo = &undo_stack[undo_stack_pos];
-
-		// Free the memory used by this undo
-		if(undo->undo_mode != UNDOMODE_MAPTILE)
-			free(undo->layout_data);
-	}
+	edit_history_pos = 0;
+	edit_saved_pos = unstashed ? -1 : 0;
 
 	// Disable objects and warn if empty object set
 	gui_disable_empty_objs(!strcmp(level->objectlabel, "Empty_ObjLayout"));
-
-	// Initial undo mark
-	undo_mark(UNDOMODE_GENS_NOHEADER);
 }
 
 
 static void level_reload(int expected_generator_count)
 {
-	// For best accuracy, this must come immediately before the level reload!
-	gui_6502_timeout_start();
-
 	// Reload level
 	NoDice_load_level_raw_data(NULL, 0, FALSE);
 
-	// Cleanup timer
-	gui_6052_timeout_end();
-
 	// Make sure no 6502 errors were reported...
 	if(NoDice_Run6502_Stop == RUN6502_STOP_END)
 	{
@@ -1080,7 +1660,7 @@ void edit_gen_remove(struct NoDice_the_level_generator *gen)
 	level_gen_remove(gen);
 
 	// Free this one!
-	free(gen);
+	NoDice_free_generator(gen);
 
 	// Reload level
 	level_reload(level_gen_count());
@@ -1096,6 +1676,26 @@ void edit_revert()
 }
 
 
+void edit_undo()
+{
+	if(undo_step(&undo_history, &redo_history))
+		edit_history_pos--;
+
+	// Update GUI with new generators
+	gui_update_for_generators();
+}
+
+
+void edit_redo()
+{
+	if(undo_step(&redo_history, &undo_history))
+		edit_history_pos++;
+
+	// Update GUI with new generators
+	gui_update_for_generators();
+}
+
+
 void edit_gen_translate(struct NoDice_the_level_generator *gen, int diff_row, int diff_col)
 {
 	int cur_row, cur_col, target_row, target_col;
@@ -1256,7 +1856,10 @@ void edit_gen_insert_generator(const struct NoDice_generator *gen, int row, int
 {
 	int index = 0;
 	struct NoDice_the_level_generator *tail = NoDice_the_level.generators,
-		*new_gen = (struct NoDice_the_level_generator *)malloc(sizeof(struct NoDice_the_level_generator));
+		*new_gen = NoDice_alloc_generator();
+
+	if(new_gen == NULL)
+		return;
 
 	if(tail != NULL)
 	{
@@ -1368,15 +1971,9 @@ void edit_startspot_alt_load()
 	// And objects!
 	undo_mark(UNDOMODE_OBJECTS);
 
-	// For best accuracy, this must come immediately before the level reload!
-	gui_6502_timeout_start();
-
 	// Load level
 	NoDice_load_level_by_addr(NoDice_the_level.header.alt_level_tileset, NoDice_the_level.header.alt_level_layout, NoDice_the_level.header.alt_level_objects);
 
-	// Cleanup timer
-	gui_6052_timeout_end();
-
 	// If an error occurred, display it!
 	if(NoDice_Run6502_Stop != RUN6502_STOP_END)
 		gui_display_6502_error(NoDice_Run6502_Stop);
@@ -1441,12 +2038,14 @@ int edit_obj_insert_object(const struct NoDice_objects *obj, int row, int col)
 
 	if(NoDice_the_level.object_count < max)
 	{
-		// Adding object to end, but it could be sorted to another position
-		struct NoDice_the_level_object *new_obj = &NoDice_the_level.objects[NoDice_the_level.object_count++];
+		struct NoDice_the_level_object *new_obj;
 
-		// Mark undo
+		// Mark undo (before the new object is counted)
 		undo_mark(UNDOMODE_OBJECTS);
 
+		// Adding object to end, but it could be sorted to another position
+		new_obj = &NoDice_the_level.objects[NoDice_the_level.object_count++];
+
 		// Configure the object
 		new_obj->id = obj - ((NoDice_the_level.tileset->id > 0) ? NoDice_config.game.objects : NoDice_config.game.map_objects);
 		new_obj->row = row;
@@ -1558,12 +2157,14 @@ int edit_link_insert_link(int row, int col)
 {
 	if(NoDice_the_level.map_link_count < MAX_MAP_LINKS)
 	{
-		// Adding linkect to end, but it could be sorted to another position
-		struct NoDice_map_link *new_link = &NoDice_the_level.map_links[NoDice_the_level.map_link_count++];
+		struct NoDice_map_link *new_link;
 
-		// Mark undo
+		// Mark undo (before the new link is counted)
 		undo_mark(UNDOMODE_LINK);
 
+		// Adding linkect to end, but it could be sorted to another position
+		new_link = &NoDice_the_level.map_links[NoDice_the_level.map_link_count++];
+
 		// Clear link memory
 		memset(new_link, 0, sizeof(struct NoDice_map_link));
 
@@ -68,169 +68,6 @@ static unsigned char gui_selected_map_tile = 0;					// Selected map tile
 
 static char path_buffer[PATH_MAX];
 
-#ifndef _WIN32
-
-#if GLIB_MAJOR_VERSION <= 2 && GLIB_MINOR_VERSION < 32
-
-static GCond *run_6502_timeout_thread_cond;
-static GThread *run_6502_timeout_thread_thread;
-static volatile gboolean run_6502_timeout_thread_cond_ack = FALSE;
-
-// Used to run a timeout in case the 6502 freezes
-static gpointer run_6502_timeout_thread(gpointer optr)
-{
-	GTimeVal time;
-
-	// Required for g_cond_timed_wait, not used
-	GMutex *unused_mutex = g_mutex_new();
-
-	// Sleep until we hit timeout or the condition is signalled
-	g_get_current_time(&time);
-	g_time_val_add(&time, 1000 * NoDice_config.core6502_timeout);
-
-	// g_cond_timed_wait returns FALSE if it timed out
-	// If condition is signalled however (i.e. 6502 core
-	// completed in a timely manner), then we don't do anything.
-	if(g_cond_timed_wait(run_6502_timeout_thread_cond, unused_mutex, &time) == FALSE)
-		// Timeout occurred; assume 6502 is frozen!
-		NoDice_Run6502_Stop = RUN6502_TIMEOUT;
-	else
-		// Acknowledge condition (if that's how we exited)
-		run_6502_timeout_thread_cond_ack = TRUE;
-
-	// Free unused mutex
-	g_mutex_free(unused_mutex);
-
-	return NULL;
-}
-
-
-void gui_6502_timeout_start()
-{
-	// Install a timer to check for lockups of the 6502 core
-	run_6502_timeout_thread_cond_ack = FALSE;
-	run_6502_timeout_thread_cond = g_cond_new();
-	run_6502_timeout_thread_thread = g_thread_create(run_6502_timeout_thread, NULL, TRUE, NULL);
-}
-
-
-void gui_6052_timeout_end()
-{
-	// If we didn't time out, send the signal
-	if(NoDice_Run6502_Stop != RUN6502_TIMEOUT)
-	{
-		// Repeatedly hit the condition in case it gets missed; this can
-		// happen if the 6502 core runs faster than the setup for g_cond_timed_wait
-		while(!run_6502_timeout_thread_cond_ack)
-		{
-			g_cond_signal(run_6502_timeout_thread_cond);
-			g_thread_yield();
-		}
-	}
-
-	// Cleanup timeout thread
-	g_thread_join(run_6502_timeout_thread_thread);
-	g_cond_free(run_6502_timeout_thread_cond);
-}
-
-#else		// End old GLIB < 2.32
-
-static GCond run_6502_timeout_thread_cond;
-static GThread *run_6502_timeout_thread_thread;
-static volatile gboolean run_6502_timeout_thread_cond_ack = FALSE;
-
-// Used to run a timeout in case the 6502 freezes
-static gpointer run_6502_timeout_thread(gpointer optr)
-{
-	gint64 time;
-
-	// Required for g_cond_timed_wait, not used
-	GMutex unused_mutex;
-	g_mutex_init(&unused_mutex);
-	
-	g_mutex_lock (&unused_mutex);
-
-	// Sleep until we hit timeout or the condition is signalled
-	time = g_get_monotonic_time() + NoDice_config.core6502_timeout * G_TIME_SPAN_SECOND;
-
-	// g_cond_timed_wait returns FALSE if it timed out
-	// If condition is signalled however (i.e. 6502 core
-	// completed in a timely manner), then we don't do anything.
-	if(g_cond_wait_until(&run_6502_timeout_thread_cond, &unused_mutex, time) == FALSE)
-		// Timeout occurred; assume 6502 is frozen!
-		NoDice_Run6502_Stop = RUN6502_TIMEOUT;
-	else
-		// Acknowledge condition (if that's how we exited)
-		run_6502_timeout_thread_cond_ack = TRUE;
-
-	g_mutex_unlock (&unused_mutex);
-		
-	return NULL;
-}
-
-
-void gui_6502_timeout_start()
-{
-	// Install a timer to check for lockups of the 6502 core
-	run_6502_timeout_thread_cond_ack = FALSE;
-	g_cond_init(&run_6502_timeout_thread_cond);
-	run_6502_timeout_thread_thread = g_thread_new("6502_timeout_thread", run_6502_timeout_thread, NULL);
-}
-
-
-void gui_6052_timeout_end()
-{
-	// If we didn't time out, send the signal
-	if(NoDice_Run6502_Stop != RUN6502_TIMEOUT)
-	{
-		// Repeatedly hit the condition in case it gets missed; this can
-		// happen if the 6502 core runs faster than the setup for g_cond_timed_wait
-		while(!run_6502_timeout_thread_cond_ack)
-		{
-			g_cond_signal(&run_6502_timeout_thread_cond);
-			g_thread_yield();
-		}
-	}
-
-	// Cleanup timeout thread
-	g_thread_join(run_6502_timeout_thread_thread);
-}
-
-#endif		// End newer GLIB
-
-#else	// End Linux
-
-	// For some reason I haven't determined yet, the above precise
-	// timeout loop doesn't work under Windows (it just deadlocks)
-	// so here's another, less precise approach.  This will work
-	// as long as the user does not save twice faster than the
-	// timeout value; otherwise there will be overlapping threads
-	// (since there's no way to force the thread to terminate early.)
-static gpointer run_6502_timeout_thread(gpointer optr)
-{
-	// Windows version: Just sleep for time specified.  If we come
-	// back and the CPU is still running, call it a timeout.
-	// Otherwise, do nothing...
-	g_usleep(NoDice_config.core6502_timeout);
-
-	if(NoDice_Run6502_Stop == RUN6502_STOP_END)
-		NoDice_Run6502_Stop = RUN6502_TIMEOUT;
-}
-
-void gui_6502_timeout_start()
-{
-	// Start the sleeper thread; if it wakes up before the CPU
-	// stops, then we call it a timeout!
-	g_thread_create(run_6502_timeout_thread, NULL, TRUE, NULL);
-}
-
-void gui_6052_timeout_end()
-{
-	// Nothing
-}
-
-#endif
-
 static GtkWidget *menu_find_item(GtkWidget *menu, const char *path)
 {
 	GList *list;
@@ -288,7 +125,16 @@ static GtkWidget *menu_find_item(GtkWidget *menu, const char *path)
 
 static void menu_edit_undo(GtkWidget *w, gpointer data)
 {
-	edit_revert();
+	edit_undo();
+
+	// Requires a redraw for map tiles
+	if(gui_start_widgets.edit_notebook_page == ENPAGE_TILES)
+		gtk_widget_queue_draw(gui_fixed_view);
+}
+
+static void menu_edit_redo(GtkWidget *w, gpointer data)
+{
+	edit_redo();
 
 	// Requires a redraw for map tiles
 	if(gui_start_widgets.edit_notebook_page == ENPAGE_TILES)
@@ -570,6 +416,38 @@ static void menu_file_open(GtkWidget *widget, gpointer callback_data)
 	}
 }
 
+// Creates and saves the open level's thumbnail
+static void gui_save_thumbnail()
+{
+	unsigned short vert_max = (!NoDice_the_level.header.is_vert) ?
+		(SCREEN_BYTESIZE / SCREEN_WIDTH * TILESIZE - 256) :
+		(SCREEN_BYTESIZE_V * SCREEN_VCOUNT / SCREEN_WIDTH * TILESIZE - 256);
+	unsigned short vert_pos = NoDice_the_level.header.vert_scroll;
+	cairo_surface_t *cs = cairo_image_surface_create(CAIRO_FORMAT_RGB24, 128, 128);
+	cairo_t *cr = cairo_create(cs);
+
+	gui_draw_info.context = (void *)cr;
+
+	//cairo_pattern_set_filter(cairo_get_source (cr), CAIRO_FILTER_NEAREST);
+
+	if(vert_pos > vert_max)
+		vert_pos = vert_max;
+
+	cairo_translate(cr, 0, -vert_pos/2);
+
+	// Set zoom factor
+	cairo_scale(cr, 0.5, 0.5);
+
+	ppu_draw(0, vert_pos, 256, 256);
+
+	cairo_surface_write_to_png(cs, gui_make_image_path(NoDice_the_level.tileset, NoDice_the_level.level));
+
+	// Done!
+	cairo_destroy(cr);
+	cairo_surface_destroy(cs);
+}
+
+
 static void menu_file_save(GtkWidget *widget, gpointer callback_data)
 {
 	// If the Alt level gets moved after saving (i.e. it is in the same bank
@@ -583,40 +461,36 @@ static void menu_file_save(GtkWidget *widget, gpointer callback_data)
 	if(edit_level_save(TRUE, TRUE))
 	{
 		// The following creates and saves the thumbnail!
-		unsigned short vert_max = (!NoDice_the_level.header.is_vert) ?
-			(SCREEN_BYTESIZE / SCREEN_WIDTH * TILESIZE - 256) :
-			(SCREEN_BYTESIZE_V * SCREEN_VCOUNT / SCREEN_WIDTH * TILESIZE - 256);
-		unsigned short vert_pos = NoDice_the_level.header.vert_scroll;
-		cairo_surface_t *cs = cairo_image_surface_create(CAIRO_FORMAT_RGB24, 128, 128);
-		cairo_t *cr = cairo_create(cs);
-
-		gui_draw_info.context = (void *)cr;
+		gui_save_thumbnail();
 
-		//cairo_pattern_set_filter(cairo_get_source (cr), CAIRO_FILTER_NEAREST);
-
-		if(vert_pos > vert_max)
-			vert_pos = vert_max;
-
-		cairo_translate(cr, 0, -vert_pos/2);
-
-		// Set zoom factor
-		cairo_scale(cr, 0.5, 0.5);
-
-		ppu_draw(0, vert_pos, 256, 256);
+		// To finish up what we started, we must now re-evalulate the alternate
+		// level so we can fix the reference to it...
+		if(current_alt != NULL)
+		{
+			// Re-resolve the layout and object addresses!
+			hdr->alt_level_layout = NoDice_get_addr_for_label(current_alt->layoutlabel);
+			hdr->alt_level_objects = NoDice_get_addr_for_label(current_alt->objectlabel);
+		}
+	}
+}
 
-		cairo_surface_write_to_png(cs, gui_make_image_path(NoDice_the_level.tileset, NoDice_the_level.level));
 
-		// Done!
-		cairo_destroy(cr);
-		cairo_surface_destroy(cs);
+// Saves every level edited since the last build along with the open one,
+// and assembles them all at once.  Only the open level is still held in
+// memory afterward; the others are loaded from the new ROM when opened,
+// and their saved alternate levels go by label, so just the open level's
+// alternate needs re-resolving.
+static void menu_file_save_all(GtkWidget *widget, gpointer callback_data)
+{
+	struct NoDice_level_header *hdr = &NoDice_the_level.header;
+	const struct NoDice_the_levels *current_alt = edit_level_find(hdr->alt_level_tileset, hdr->alt_level_layout, hdr->alt_level_objects);
 
-		//////////////
+	if(edit_level_save_all())
+	{
+		gui_save_thumbnail();
 
-		// To finish up what we started, we must now re-evalulate the alternate
-		// level so we can fix the reference to it...
 		if(current_alt != NULL)
 		{
-			// Re-resolve the layout and object addresses!
 			hdr->alt_level_layout = NoDice_get_addr_for_label(current_alt->layoutlabel);
 			hdr->alt_level_objects = NoDice_get_addr_for_label(current_alt->objectlabel);
 		}
@@ -624,6 +498,37 @@ static void menu_file_save(GtkWidget *widget, gpointer callback_data)
 }
 
 
+// Returns 1 if it's okay to quit, asking first if levels have unsaved changes
+static int gui_quit_check()
+{
+	char buffer[128];
+	int count = edit_dirty_count();
+
+	if(count > 0)
+	{
+		snprintf(buffer, sizeof(buffer), "%i other level(s) have unsaved changes, which will be lost.  Quit anyway?", count);
+
+		return gui_ask_question(buffer);
+	}
+
+	return 1;
+}
+
+
+static void menu_file_quit(GtkWidget *widget, gpointer callback_data)
+{
+	if(gui_quit_check())
+		gtk_main_quit();
+}
+
+
+// Closing the window asks the same as File > Quit; TRUE keeps it open
+static gboolean gui_main_window_delete(GtkWidget *widget, GdkEvent *event, gpointer user_data)
+{
+	return !gui_quit_check();
+}
+
+
 static void menu_file_tiletest(GtkWidget *widget, gpointer callback_data)
 {
 	NoDice_tile_test();
@@ -647,12 +552,14 @@ static GtkItemFactoryEntry menu_items[] = {
   { "/File/_New",     "<CTRL>N", menu_file_new,    0, "<StockItem>", GTK_STOCK_NEW },
   { "/File/_Open Level from ROM...",    "<CTRL>O", menu_file_open,    0, "<StockItem>", GTK_STOCK_OPEN },
   { "/File/_Save Level to ROM",    "<CTRL>S", menu_file_save,    0, "<StockItem>", GTK_STOCK_SAVE },
+  { "/File/Save _All Levels to ROM",    "<CTRL><SHIFT>S", menu_file_save_all,    0, "<Item>" },
   { "/File/sep1",     NULL,         NULL,           0, "<Separator>" },
   { "/File/Test Tiles", NULL,	menu_file_tiletest,	0, "<Item>" },
   { "/File/sep1",     NULL,         NULL,           0, "<Separator>" },
-  { "/File/_Quit",    "<CTRL>Q", gtk_main_quit, 0, "<StockItem>", GTK_STOCK_QUIT },
+  { "/File/_Quit",    "<CTRL>Q", menu_file_quit, 0, "<StockItem>", GTK_STOCK_QUIT },
   { "/_Edit",         NULL,         NULL,           0, "<Branch>" },
   { "/Edit/_Undo",    "<CTRL>Z",    menu_edit_undo, 0, "<StockItem>", GTK_STOCK_UNDO },
+  { "/Edit/_Redo",    "<CTRL>Y",    menu_edit_redo, 0, "<StockItem>", GTK_STOCK_REDO },
   { "/Edit/_Delete",  "Delete",     menu_edit_delete,0, "<StockItem>", GTK_STOCK_DELETE },
   { "/Edit/Arrange/_Bring to Front",  "<CTRL>Prior", menu_edit_arrange,0, "<StockItem>", GTK_STOCK_GOTO_LAST },
   { "/Edit/Arrange/Bring _Forward",  "Prior",        menu_edit_arrange,1, "<StockItem>", GTK_STOCK_GO_FORWARD },
@@ -1216,6 +1123,7 @@ void gui_update_for_generators()
 	gtk_widget_set_sensitive(menu_find_item(gui_menu, "/_Edit"), enable_for_load);
 	gtk_widget_set_sensitive(menu_find_item(gui_menu, "/_View"), enable_for_load);
 	gtk_widget_set_sensitive(menu_find_item(gui_menu, "/_File/_Save Level to ROM"), enable_for_load);
+	gtk_widget_set_sensitive(menu_find_item(gui_menu, "/_File/Save _All Levels to ROM"), enable_for_load);
 
 	if(enable_for_load)
 		// World map has no use for the Tile Hints
@@ -2238,6 +2146,7 @@ int gui_init()
 	gtk_window_set_title (GTK_WINDOW (gui_main_window), "NoDice");
 	gtk_window_set_position (GTK_WINDOW (gui_main_window), GTK_WIN_POS_CENTER);
 	gtk_widget_realize (gui_main_window);
+	g_signal_connect (gui_main_window, "delete-event", G_CALLBACK(gui_main_window_delete), NULL);
 	g_signal_connect (gui_main_window, "destroy", gtk_main_quit, NULL);
 
 	// Menu power v-box
@@ -2340,6 +2249,26 @@ static void gui_do_load_complete_actions()
 }
 
 
+// After a build's PRG refresh; the bank's free space (and the level
+// size it was figured against) only needs redoing if its bank changed
+void gui_PRG_refreshed()
+{
+	int bank;
+
+	if(NoDice_the_level.tiles == NULL)
+		return;
+
+	bank = NoDice_get_tileset_bank(NoDice_the_level.tileset->id);
+
+	if(bank < 0 || NoDice_PRG_bank_changed(bank))
+	{
+		gui_bank_free_space = NoDice_get_tilebank_free_space(NoDice_the_level.tileset->id);
+		gui_level_base_size = gui_level_calc_size();
+		gui_statusbar_update();
+	}
+}
+
+
 void gui_set_subtitle(const char *subtitle)
 {
 	snprintf(path_buffer, PATH_MAX, "NoDice - %s", subtitle);
@@ -11,20 +11,6 @@ void gui_display_6502_error(enum RUN6502_STOP_REASON reason)
 {
 	GtkWidget *dialog;
 	const char *s3 = "";
-	const char *revertReasons[] =
-	{
-		// Core triggered
-		"Error??  6502 apparently still running!",	// RUN6502_STOP_NOTSTOPPED (shouldn't be used)
-		"No apparent error",					// RUN6502_STOP_END (good day, shouldn't be used either)
-		"Internal error",						// RUN6502_INIT_ERROR
-		"Generator wrote out of tile memory bounds (low, top/left)",	// RUN6502_LEVEL_OORW_LOW
-		"Generator wrote out of tile memory bounds (high, bottom/right)",	// RUN6502_LEVEL_OORW_HIGH
-		"A generator appeared to be too large",		// RUN6502_GENERATOR_TOO_LARGE
-
-		// Externally triggered
-		"6502 core appears to have frozen (NOTE: May have to change config \"coretimeout\")",	// RUN6502_TIMEOUT
-		"Did not return with the expected number of generators",	// RUN6502_GENGENCOUNT_MISMATCH
-	};
 
 	if(reason == RUN6502_INIT_ERROR)
 		s3 = NoDice_Error();
@@ -34,7 +20,7 @@ void gui_display_6502_error(enum RUN6502_STOP_REASON reason)
 							   GTK_MESSAGE_ERROR,
 							   GTK_BUTTONS_CLOSE,
 							   "EDIT REVERTED: %s %s",
-							   revertReasons[reason], s3);
+							   NoDice_stop_reason_string(reason), s3);
 	gtk_dialog_run (GTK_DIALOG (dialog));
 	gtk_widget_destroy(GTK_WIDGET(dialog));
 }
@@ -69,6 +55,136 @@ int gui_ask_question(const char *prompt)
 }
 
 
+// Build popup; the assembler runs on its own thread and its output is
+// moved into the log a few times a second
+struct _gui_build_popup_widgets
+{
+	GtkWidget *popup;
+	GtkWidget *status;		// What the build is doing
+	GtkWidget *log;			// Assembler output
+	GtkWidget *button_cancel;
+	GtkWidget *button_close;
+
+	struct NoDice_build *build;
+	guint timer;
+};
+
+static gboolean gui_build_popup_poll(gpointer user_data)
+{
+	struct _gui_build_popup_widgets *widgets = (struct _gui_build_popup_widgets *)user_data;
+	GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(widgets->log));
+	enum NoDice_build_state state = NoDice_build_state(widgets->build);
+	GtkTextIter end;
+	char line[512];
+	int added = 0;
+
+	while(NoDice_build_next_line(widgets->build, line, sizeof(line)))
+	{
+		gtk_text_buffer_get_end_iter(buffer, &end);
+		gtk_text_buffer_insert(buffer, &end, line, -1);
+		gtk_text_buffer_insert(buffer, &end, "\n", -1);
+		added = 1;
+	}
+
+	if(added)
+		gtk_text_view_scroll_mark_onscreen(GTK_TEXT_VIEW(widgets->log), gtk_text_buffer_get_mark(buffer, "end"));
+
+	// The state was read before taking the lines, so once it's no longer
+	// running every line the build put out has been taken
+	if(state == BUILD_RUNNING)
+		return TRUE;
+
+	widgets->timer = 0;
+
+	if(state == BUILD_SUCCEEDED)
+		gtk_dialog_response(GTK_DIALOG(widgets->popup), GTK_RESPONSE_ACCEPT);
+	else
+	{
+		// Keep the log up so the errors can be read
+		gtk_label_set_text(GTK_LABEL(widgets->status), (state == BUILD_CANCELLED) ? "Build cancelled." : "ROM ASSEMBLY FAILED; see the output below.");
+		gtk_widget_hide(widgets->button_cancel);
+		gtk_widget_show(widgets->button_close);
+	}
+
+	return FALSE;
+}
+
+
+int gui_build_popup()
+{
+	struct _gui_build_popup_widgets widgets;
+	GtkTextBuffer *buffer;
+	GtkTextIter end;
+	GtkAllocation alloc;
+	int response, result;
+
+	if( (widgets.build = NoDice_build_start()) == NULL)
+	{
+		gui_display_message(TRUE, NoDice_Error());
+		return FALSE;
+	}
+
+	widgets.popup = gtk_dialog_new_with_buttons("Building ROM", GTK_WINDOW(gui_main_window),
+		GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+		NULL);
+
+	widgets.button_cancel = gtk_dialog_add_button(GTK_DIALOG(widgets.popup), GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL);
+	widgets.button_close = gtk_dialog_add_button(GTK_DIALOG(widgets.popup), GTK_STOCK_CLOSE, GTK_RESPONSE_CLOSE);
+
+	gtk_widget_get_allocation(GTK_WIDGET(gui_main_window), &alloc);
+	gtk_widget_set_size_request(widgets.popup, (int)((double)alloc.width * 0.75), (int)((double)alloc.height * 0.60));
+
+	widgets.status = gtk_label_new("Assembling...");
+	gtk_box_pack_start(GTK_BOX(GTK_DIALOG(widgets.popup)->vbox), widgets.status, FALSE, FALSE, 5);
+
+	// Output log
+	{
+		GtkWidget *frame = gtk_frame_new("Output");
+		GtkWidget *scrolled_window = gtk_scrolled_window_new(NULL, NULL);
+
+		widgets.log = gtk_text_view_new();
+		gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(widgets.log), GTK_WRAP_WORD_CHAR);
+		gtk_text_view_set_editable(GTK_TEXT_VIEW(widgets.log), FALSE);
+
+		// Scrolled to as output comes in
+		buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(widgets.log));
+		gtk_text_buffer_get_end_iter(buffer, &end);
+		gtk_text_buffer_create_mark(buffer, "end", &end, FALSE);
+
+		gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+		gtk_container_add(GTK_CONTAINER(scrolled_window), widgets.log);
+		gtk_container_add(GTK_CONTAINER(frame), scrolled_window);
+
+		gtk_box_pack_start(GTK_BOX(GTK_DIALOG(widgets.popup)->vbox), frame, TRUE, TRUE, 5);
+	}
+
+	// Make sure all widgets show up (Close is only for after a failure)
+	gtk_widget_show_all(widgets.popup);
+	gtk_widget_hide(widgets.button_close);
+
+	widgets.timer = g_timeout_add(50, gui_build_popup_poll, &widgets);
+
+	// Cancel (or closing the window) stops the build, but the popup stays
+	// up until the poll sees it's over
+	while( (response = gtk_dialog_run(GTK_DIALOG(widgets.popup))) != GTK_RESPONSE_ACCEPT && widgets.timer != 0)
+	{
+		NoDice_build_cancel(widgets.build);
+		gtk_label_set_text(GTK_LABEL(widgets.status), "Cancelling...");
+		gtk_widget_set_sensitive(widgets.button_cancel, FALSE);
+	}
+
+	if(widgets.timer != 0)
+		g_source_remove(widgets.timer);
+
+	result = (NoDice_build_wait(widgets.build) == BUILD_SUCCEEDED);
+
+	NoDice_build_destroy(widgets.build);
+	gtk_widget_destroy(widgets.popup);
+
+	return result;
+}
+
+
 // Widgets that require updates when the selected level changes
 struct _gui_open_level_popup_desc_widgets
 {
@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include "NoDiceLib.h"
+
+
+static void usage()
+{
+	fprintf(stderr,
+		"NoDiceCLI [command] [options]\n"
+		"\n"
+		"Commands:\n"
+		"decode [-j threads] [-r passes] [-p report] [-csv]: Decode every level\n"
+		"  and world map in game.xml and report any which fail to load.  Uses\n"
+		"  one thread per CPU unless otherwise specified by -j.  With -r, the\n"
+		"  whole decode is done that many times and the CPU time it took per\n"
+		"  pass is reported.  With -p, the 6502 is profiled and a report of\n"
+		"  where its time went (by FNS label and by generator, over every pass)\n"
+		"  is written to the report file (\"-\" for stdout), as CSV if -csv is\n"
+		"  given; -p needs NoDiceLib built with PROFILE6502 (make PROFILE=1).\n"
+		"\n"
+		"symbols: Report how long loading the FNS symbols takes, parsing the\n"
+		"  text and from the binary cache beside it.\n"
+		"\n"
+		"banks [-a]: Report the free space at the end of each PRG bank holding\n"
+		"  level layouts or objects, and the level data in it by offset.  With\n"
+		"  -a, every PRG bank is listed.\n"
+		"\n"
+		"chrtest: Check each CHR decoder the CPU supports against the plain C\n"
+		"  one, over all of CHR ROM and odd tile counts.  Exits non-zero on any\n"
+		"  difference.\n"
+		"\n"
+		);
+}
+
+
+static int cmd_decode(int argc, char *argv[])
+{
+	struct NoDice_decode_result *results;
+	struct NoDice_profile *profile = NULL;
+	const char *report = NULL;
+	int i, result_count, threads = 0, passes = 0, failures = 0, csv = 0;
+	clock_t start;
+
+	for(i = 0; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "-j") && (i + 1) < argc)
+			threads = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-r") && (i + 1) < argc)
+			passes = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-p") && (i + 1) < argc)
+			report = argv[++i];
+		else if(!strcmp(argv[i], "-csv"))
+			csv = 1;
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	if(report != NULL && (profile = NoDice_profile_create()) == NULL)
+	{
+		fprintf(stderr, "Profile failure: %s\n", NoDice_Error());
+		return 1;
+	}
+
+	start = clock();
+
+	// Only the last pass's results are kept
+	for(i = 0; i < ((passes > 0) ? passes : 1); i++)
+	{
+		if(i > 0)
+			NoDice_decode_free(results, result_count);
+
+		if( (results = NoDice_decode_all(threads, profile, &result_count)) == NULL)
+		{
+			fprintf(stderr, "Decode failure: %s\n", NoDice_Error());
+			NoDice_profile_destroy(profile);
+			return 1;
+		}
+	}
+
+	for(i = 0; i < result_count; i++)
+	{
+		const struct NoDice_decode_result *result = &results[i];
+
+		if(result->stop == RUN6502_STOP_END)
+		{
+			const struct NoDice_the_level_generator *gen;
+			int gen_count = 0;
+
+			for(gen = result->decoded.generators; gen != NULL; gen = gen->next)
+				gen_count++;
+
+			printf("%s: %s: OK (%i generators, %i objects)\n", result->tileset->name, result->level->name, gen_count, result->decoded.object_count);
+		}
+		else
+		{
+			printf("%s: %s: FAILED: %s %s\n", result->tileset->name, result->level->name, NoDice_stop_reason_string(result->stop), (result->error != NULL) ? result->error : "");
+			failures++;
+		}
+	}
+
+	printf("%i levels decoded, %i failed\n", result_count - failures, failures);
+
+	if(passes > 0)
+		printf("%i passes, %.3f ms CPU per pass\n", passes, (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC / passes);
+
+	NoDice_decode_free(results, result_count);
+
+	if(profile != NULL)
+	{
+		FILE *out = !strcmp(report, "-") ? stdout : fopen(report, "w");
+
+		if(out == NULL)
+		{
+			fprintf(stderr, "Failed to open %s for writing\n", report);
+			failures++;
+		}
+		else
+		{
+			if(!NoDice_profile_report(profile, out, csv))
+			{
+				fprintf(stderr, "Profile failure: %s\n", NoDice_Error());
+				failures++;
+			}
+
+			if(out != stdout)
+				fclose(out);
+		}
+
+		NoDice_profile_destroy(profile);
+	}
+
+	return (failures > 0) ? 1 : 0;
+}
+
+
+static int cmd_symbols(int argc, char *argv[])
+{
+	struct NoDice_symbol_stats stats;
+
+	if(argc > 0)
+	{
+		usage();
+		return 1;
+	}
+
+	NoDice_symbol_stats(&stats);
+	printf("Startup: %i labels from %s\n", stats.label_count, stats.from_cache ? "cache" : "FNS");
+
+	// Once each way, so both times are current
+	if(!NoDice_reload_symbols(0) || !NoDice_reload_symbols(1))
+	{
+		fprintf(stderr, "Symbol failure: %s\n", NoDice_Error());
+		return 1;
+	}
+
+	NoDice_symbol_stats(&stats);
+
+	if(!stats.from_cache)
+		printf("Cache could not be written or read; FNS parsed every time\n");
+
+	printf("Parse FNS:  %8.3f ms\n", stats.parse_ms);
+	printf("Load cache: %8.3f ms\n", stats.cache_ms);
+
+	return 0;
+}
+
+
+static int cmd_banks(int argc, char *argv[])
+{
+	const struct NoDice_bank_usage *banks;
+	int i, j, bank_count, all = 0, total_free = 0;
+
+	for(i = 0; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "-a"))
+			all = 1;
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	if( (banks = NoDice_get_bank_usage(&bank_count)) == NULL)
+	{
+		fprintf(stderr, "Bank failure: %s\n", NoDice_Error());
+		return 1;
+	}
+
+	for(i = 0; i < bank_count; i++)
+	{
+		const struct NoDice_bank_usage *bank = &banks[i];
+		int level_bytes = 0;
+
+		if(bank->range_count == 0 && !all)
+			continue;
+
+		for(j = 0; j < bank->range_count; j++)
+			level_bytes += bank->ranges[j].end - bank->ranges[j].start;
+
+		printf("Bank %2i: %5i bytes free, %5i bytes of level data in %i ranges\n", i, bank->free_space, level_bytes, bank->range_count);
+
+		for(j = 0; j < bank->range_count; j++)
+		{
+			const struct NoDice_bank_range *range = &bank->ranges[j];
+
+			printf("  %04X-%04X %5i  %s: %s (%s)\n", range->start, range->end - 1, range->end - range->start,
+				range->tileset->name, range->level->name, range->is_objects ? range->level->objectlabel : range->level->layoutlabel);
+		}
+
+		total_free += bank->free_space;
+	}
+
+	printf("%i bytes free in the banks listed\n", total_free);
+
+	return 0;
+}
+
+
+static int cmd_chrtest(int argc, char *argv[])
+{
+	struct NoDice_chr_test test;
+	int i;
+
+	if(argc > 0)
+	{
+		usage();
+		return 1;
+	}
+
+	if(!NoDice_chr_test(&test))
+	{
+		fprintf(stderr, "CHR decode mismatch: %s\n", NoDice_Error());
+		return 1;
+	}
+
+	printf("%i CHR ROM tiles decoded the same by:", test.tiles);
+
+	for(i = 0; i < test.version_count; i++)
+		printf(" %s", test.versions[i]);
+
+	printf("\n");
+
+	return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+	int result;
+
+	if(argc < 2)
+	{
+		usage();
+		return 1;
+	}
+
+	if(!NoDice_Init())
+	{
+		fprintf(stderr, "Initialization failure: %s\n", NoDice_Error());
+
+		NoDice_Shutdown();
+
+		return 1;
+	}
+
+	if(!strcmp(argv[1], "decode"))
+		result = cmd_decode(argc - 2, argv + 2);
+	else if(!strcmp(argv[1], "symbols"))
+		result = cmd_symbols(argc - 2, argv + 2);
+	else if(!strcmp(argv[1], "banks"))
+		result = cmd_banks(argc - 2, argv + 2);
+	else if(!strcmp(argv[1], "chrtest"))
+		result = cmd_chrtest(argc - 2, argv + 2);
+	else
+	{
+		usage();
+		result = 1;
+	}
+
+	NoDice_Shutdown();
+
+	return result;
+}
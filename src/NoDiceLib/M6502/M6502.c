@@ -45,6 +45,17 @@ INLINE byte Op6502(register word A)
 extern int Opt6502(M6502 *R);
 #endif
 
+/** DECODE6502 ***********************************************/
+/** With this #define present, Run6502() asks Decode6502() **/
+/** for a predecoded block at each PC outside of one, and   **/
+/** runs any it gets through Block6502(), which takes the   **/
+/** opcodes and operands from the block instead of reading  **/
+/** them. Exec6502() and the DEBUG trace don't use blocks.  **/
+/*************************************************************/
+#if defined(DECODE6502) && !defined(EXEC6502)
+static void Block6502(M6502 *R);
+#endif
+
 /** FAST_RDOP ************************************************/
 /** With this #define not present, Rd6502() should perform  **/
 /** the functions of Op6502().                              **/
@@ -208,6 +219,9 @@ void Reset6502(M6502 *R)
   R->ICount=R->IPeriod;
   R->IRequest=INT_NONE;
   R->AfterCLI=0;
+#ifdef DECODE6502
+  R->Dec=0;
+#endif
 }
 
 /** Exec6502() ***********************************************/
@@ -220,6 +234,9 @@ int Exec6502(M6502 *R,int RunCycles)
 {
   register pair J,K;
   register byte I;
+#ifdef PROFILE6502
+  word ProfPC;
+#endif
 
   /* Execute requested number of cycles */
   while(RunCycles>0)
@@ -232,8 +249,14 @@ int Exec6502(M6502 *R,int RunCycles)
       if(!Debug6502(R)) return(RunCycles);
 #endif
 
+#ifdef PROFILE6502
+    ProfPC=R->PC.W;
+#endif
     I=Op6502(R->PC.W++);
     RunCycles-=Cycles[I];
+#ifdef PROFILE6502
+    if(R->Profile) Profile6502(R,ProfPC,Cycles[I]);
+#endif
     switch(I)
     {
 #include "Codes.h"
@@ -278,6 +301,9 @@ word Run6502(M6502 *R)
 {
   register pair J,K;
   register byte I;
+#ifdef PROFILE6502
+  word ProfPC;
+#endif
 
   for(;;)
   {
@@ -293,11 +319,24 @@ word Run6502(M6502 *R)
       if(!Debug6502(R)) return(R->PC.W);
 #endif
 
-    I=Op6502(R->PC.W++);
-    R->ICount-=Cycles[I];
-    switch(I)
+#ifdef DECODE6502
+    /* Run from the predecoded block at PC if there is one */
+    if((R->Dec=Decode6502(R))) Block6502(R);
+    else
+#endif
     {
+#ifdef PROFILE6502
+      ProfPC=R->PC.W;
+#endif
+      I=Op6502(R->PC.W++);
+      R->ICount-=Cycles[I];
+#ifdef PROFILE6502
+      if(R->Profile) Profile6502(R,ProfPC,Cycles[I]);
+#endif
+      switch(I)
+      {
 #include "Codes.h"
+      }
     }
 
 #endif /* !S60 */
@@ -329,3 +368,61 @@ word Run6502(M6502 *R)
   return(R->PC.W);
 }
 #endif /* !EXEC6502 */
+
+/** Block6502() **********************************************/
+/** This function runs the predecoded block at R->Dec. Its  **/
+/** operands come from the block, so the macros fetching    **/
+/** them are redefined for it below; Op6502() is left for   **/
+/** the stack and for JSR, which still read through memory. **/
+/** The block stops early if it jumps, runs out of cycles,  **/
+/** or R->Dec is cleared by a bank switch and the like.     **/
+/*************************************************************/
+#if defined(DECODE6502) && !defined(EXEC6502)
+#undef MC_Zp
+#undef MC_Zx
+#undef MC_Zy
+#undef MC_Ix
+#undef MC_Iy
+#undef MR_Im
+#undef M_LDWORD
+#undef M_JR
+#define MC_Zp(Rg)	Rg.W=E->Arg.B.l;R->PC.W++
+#define MC_Zx(Rg)	Rg.W=(byte)(E->Arg.B.l+R->X);R->PC.W++
+#define MC_Zy(Rg)	Rg.W=(byte)(E->Arg.B.l+R->Y);R->PC.W++
+#define MC_Ix(Rg)	K.W=(byte)(E->Arg.B.l+R->X);R->PC.W++; \
+			Rg.B.l=Op6502(K.W++);Rg.B.h=Op6502(K.W)
+#define MC_Iy(Rg)	K.W=E->Arg.B.l;R->PC.W++; \
+			Rg.B.l=Op6502(K.W++);Rg.B.h=Op6502(K.W); \
+			Rg.W+=R->Y
+#define MR_Im(Rg)	Rg=E->Arg.B.l;R->PC.W++
+#define M_LDWORD(Rg)	Rg.W=E->Arg.W;R->PC.W+=2
+#define M_JR		R->PC.W+=(offset)E->Arg.B.l+1;R->ICount--
+
+static void Block6502(M6502 *R)
+{
+  register pair J,K;
+  register byte I;
+  register const Dec6502 *E=R->Dec;
+  word PC;
+
+  for(;;)
+  {
+    /* Where the next instruction is unless this one jumps */
+    PC=R->PC.W+E->Len;
+
+    I=E->Op;
+    R->PC.W++;
+    R->ICount-=Cycles[I];
+#ifdef PROFILE6502
+    if(R->Profile) Profile6502(R,PC-E->Len,Cycles[I]);
+#endif
+    switch(I)
+    {
+#include "Codes.h"
+    }
+
+    if(E->End||(R->PC.W!=PC)||(R->ICount<=0)||!R->Dec) return;
+    E+=E->Len;
+  }
+}
+#endif /* DECODE6502 && !EXEC6502 */
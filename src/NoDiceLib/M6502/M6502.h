@@ -66,6 +66,24 @@ typedef union
   word W;
 } pair;
 
+/** Dec6502 **************************************************/
+/** One predecoded instruction, as handed out by            **/
+/** Decode6502() when DECODE6502 is #defined. A block is    **/
+/** run from its first instruction to the one marked End;   **/
+/** each instruction's successor is Len entries on, so a    **/
+/** table with an entry for every address of ROM holds the  **/
+/** blocks starting at all of them.                         **/
+/*************************************************************/
+#ifdef DECODE6502
+typedef struct
+{
+  byte Op;            /* Opcode                              */
+  byte Len;           /* Length in bytes, 0 if not decoded   */
+  byte End;           /* Set if the block ends here          */
+  pair Arg;           /* Operand bytes following the opcode  */
+} Dec6502;
+#endif
+
 typedef struct
 {
   byte A,P,X,Y,S;     /* CPU registers and program counter   */
@@ -80,7 +98,12 @@ typedef struct
   byte TrapBadOps;    /* Set to 1 to warn of illegal opcodes */
   word Trap;          /* Set Trap to address to trace from   */
   byte Trace;         /* Set Trace=1 to start tracing        */
+  byte Profile;       /* Set Profile=1 to call Profile6502() */
   void *User;         /* Arbitrary user data (ID,RAM*,etc.)  */
+#ifdef DECODE6502
+  const Dec6502 *Dec; /* Block being run; set Dec=0 if the   */
+                      /* memory it was decoded from changes  */
+#endif
 } M6502;
 
 /** Reset6502() **********************************************/
@@ -126,6 +149,29 @@ void Wr6502(register word Addr,register byte Value);
 byte Rd6502(register word Addr);
 byte Op6502(register word Addr);
 
+/** Decode6502() *********************************************/
+/** This function is called before each instruction that   **/
+/** isn't part of a block already running, when DECODE6502 **/
+/** is #defined. It should return the predecoded block      **/
+/** starting at R->PC, or return 0 if the instruction must  **/
+/** be fetched through Rd6502() (e.g. it isn't in ROM or    **/
+/** reading it has side effects.) The block is run without  **/
+/** calling Rd6502() for its opcodes or operands until it   **/
+/** ends, jumps, runs out of cycles, or R->Dec is set to 0. **/
+/************************************ TO BE WRITTEN BY USER **/
+#ifdef DECODE6502
+const Dec6502 *Decode6502(register M6502 *R);
+#endif
+
+/** Profile6502() ********************************************/
+/** This function is called for each instruction executed   **/
+/** when PROFILE6502 is #defined and Profile!=0, given the  **/
+/** address of its opcode and the base cycles it takes.     **/
+/************************************ TO BE WRITTEN BY USER **/
+#ifdef PROFILE6502
+void Profile6502(register M6502 *R,word PC,byte Cycles);
+#endif
+
 /** Debug6502() **********************************************/
 /** This function should exist if DEBUG is #defined. When   **/
 /** Trace!=0, it is called after each command executed by   **/
@@ -2,11 +2,13 @@
 #define _NODICELIB_H
 
 #include <limits.h>
+#include <stdio.h>
 
 #ifdef _MSC_VER
 // MSVC compatibility fixes
 #if _MSC_VER < 1900 //vs2015 already have this function
 #define snprintf _snprintf
+#define vsnprintf _vsnprintf
 #endif
 #define chdir _chdir
 #define strcasecmp _stricmp
@@ -19,7 +21,9 @@ char *stristr(const char *String, const char *Pattern);
 // File extensions off of "filebase" and other filesystem defines
 #define EXT_ROM			".nes"	// Produced ROM file
 #define EXT_SYMBOLS			".fns"	// "fns" symbol listing file
+#define EXT_SYMBOL_CACHE	".fns.bin"	// Binary index of the symbol listing (built by NoDice)
 #define EXT_ASM			".asm"	// Game assembly source
+#define EXT_LAYOUT_BIN		".bin"	// Packed level layout (see "layoutformat" in game.xml)
 #define SUBDIR_PRG			"PRG"
 #define SUBDIR_LEVELS		SUBDIR_PRG "/levels"
 #define SUBDIR_OBJECTS		SUBDIR_PRG "/objects"
@@ -91,10 +95,12 @@ extern struct NoDice_configuration
 		char *_build_str;		// Pointer to split build string, just required for freeing later
 		char **build_argv;		// Build executable (index 0) and additional parameters
 		enum BUILDERR builderr;	// Error check style
+		int force;				// Build at startup even if the ROM is up to date
 	} buildinfo;
 
 	const char *filebase;
-	int core6502_timeout;
+	unsigned long core6502_budget;	// 6502 cycles a level load may run before it's considered frozen
+	unsigned long undo_budget;		// Bytes the editor's undo/redo history may use
 	unsigned short level_range_check_high;
 
 	// Built from the game.xml
@@ -105,6 +111,7 @@ extern struct NoDice_configuration
 			const char *title;				// Game title
 			const char *warpzone;			// Warp Zone layout label definition
 			const char *object_set_bank;	// The bank ASM file which specifies 
+			int layout_incbin;				// Level layouts are saved as binary, pulled in by .incbin
 		} options;
 
 		struct NoDice_tilehint
@@ -382,21 +389,191 @@ enum RUN6502_STOP_REASON
 extern volatile enum RUN6502_STOP_REASON NoDice_Run6502_Stop;	// Set stop reason to halt execution
 
 int NoDice_PRG_refresh();
+
+// PRG banks (8KB); each refresh compares every bank to what was there,
+// and only what depended on the banks which changed is thrown out
+int NoDice_PRG_bank_count();
+int NoDice_PRG_bank_changed(int bank);		// Set if the last NoDice_PRG_refresh changed the bank
+unsigned int NoDice_PRG_bank_hash(int bank);	// Hash of the bank's contents
+int NoDice_get_tileset_bank(unsigned char tileset);	// Bank holding the tileset's levels (-1 if unknown)
+
+// Patches a level edit that doesn't change its size straight into the
+// ROM, leaving the assembler for later; see NoDice_fast_apply_level()
+int NoDice_fast_apply_level(const struct NoDice_the_levels *level, int layout, int objects);
 const unsigned char *NoDice_get_raw_CHR_bank(unsigned char bank);
 const unsigned char *NoDice_pack_level(int *size, int need_header);
 void NoDice_load_level(unsigned char tileset, const char *level_layout, const char *object_layout);
 void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, unsigned short object_address);
 void NoDice_load_level_raw_data(const unsigned char *data, int size, int has_header);
 unsigned short NoDice_get_addr_for_label(const char *label);
+const char *NoDice_get_label_for_addr(unsigned short addr);
+
+// Label handles; a handle's address is looked up once each time the FNS
+// is loaded, so hot labels needn't be looked up by name every time
+typedef int NoDice_label_handle;
+NoDice_label_handle NoDice_get_label_handle(const char *label);
+unsigned short NoDice_get_addr_for_handle(NoDice_label_handle handle);
+
+// Symbol loading; the parsed FNS is kept in a binary cache beside it
+// (EXT_SYMBOL_CACHE), used instead of parsing while the FNS is unchanged
+struct NoDice_symbol_stats
+{
+	int label_count;	// Labels loaded
+	int from_cache;		// Set if the last load came from the cache
+	double parse_ms;	// CPU time of the last FNS parse (0 if none yet)
+	double cache_ms;	// CPU time of the last cache load (0 if none yet)
+};
+int NoDice_reload_symbols(int use_cache);
+void NoDice_symbol_stats(struct NoDice_symbol_stats *stats);
 int NoDice_get_tilebank_free_space(unsigned char tileset);
 const unsigned char *NoDice_get_rest_table();
 int NoDice_get_music_context(struct NoDice_music_context *context, const char *header_index_name, const char *SEL_name, unsigned char music_index);
 void NoDice_tile_test();
+
+// Contexts; each holds its own 6502, RAM and loaded level so levels may be
+// loaded on more than one thread at a time (one context per thread!)  The
+// functions above all work on the default context, whose level and stop
+// reason are NoDice_the_level and NoDice_Run6502_Stop.
+struct NoDice_context;
+struct NoDice_context *NoDice_context_create();
+void NoDice_context_destroy(struct NoDice_context *context);
+struct NoDice_context *NoDice_context_default();
+struct NoDice_level *NoDice_context_level(struct NoDice_context *context);
+enum RUN6502_STOP_REASON NoDice_context_stop_reason(struct NoDice_context *context);
+void NoDice_context_stop(struct NoDice_context *context, enum RUN6502_STOP_REASON reason);
+const unsigned char *NoDice_context_pack_level(struct NoDice_context *context, int *size, int need_header);
+void NoDice_context_load_level(struct NoDice_context *context, unsigned char tileset, const char *level_layout, const char *object_layout);
+void NoDice_context_load_level_by_addr(struct NoDice_context *context, unsigned char tileset, unsigned short address, unsigned short object_address);
+void NoDice_context_load_level_raw_data(struct NoDice_context *context, const unsigned char *data, int size, int has_header);
+
+// The level's generators belong to it and are released in bulk when the
+// next level loads; a generator to be added to the list must come from
+// here, and one taken out of it is given back with NoDice_free_generator
+struct NoDice_the_level_generator *NoDice_alloc_generator();
+void NoDice_free_generator(struct NoDice_the_level_generator *gen);
+struct NoDice_the_level_generator *NoDice_context_alloc_generator(struct NoDice_context *context);
+void NoDice_context_free_generator(struct NoDice_context *context, struct NoDice_the_level_generator *gen);
+
+// 6502 traps; callback is made when the 6502 reads the address (including opcode fetch)
+typedef void (*NoDice_trap_callback)(struct NoDice_context *context, unsigned short addr, void *user);
+int NoDice_trap_add(unsigned short addr, NoDice_trap_callback callback, void *user);
+void NoDice_trap_remove(unsigned short addr, NoDice_trap_callback callback, void *user);
+int NoDice_context_trap_add(struct NoDice_context *context, unsigned short addr, NoDice_trap_callback callback, void *user);
+void NoDice_context_trap_remove(struct NoDice_context *context, unsigned short addr, NoDice_trap_callback callback, void *user);
+const char *NoDice_stop_reason_string(enum RUN6502_STOP_REASON reason);
+
+// Generator replay cache; generators seen before with the same parameters
+// and inputs have their tile writes replayed rather than emulated
+struct NoDice_replay_stats
+{
+	unsigned long hits;		// Generators replayed from the cache
+	unsigned long misses;	// Generators emulated (and recorded)
+	unsigned long impure;	// Generators emulated because they can't be replayed
+	int entries;			// Generators currently cached
+};
+void NoDice_replay_stats(struct NoDice_replay_stats *stats);
+void NoDice_context_replay_stats(struct NoDice_context *context, struct NoDice_replay_stats *stats);
+
+// 6502 profiler; while set on a context, every instruction it runs is
+// counted by PC and by generator.  Only if built with PROFILE6502 ("make
+// PROFILE=1"); otherwise NoDice_profile_create() fails.
+struct NoDice_profile;
+struct NoDice_profile *NoDice_profile_create();
+void NoDice_profile_destroy(struct NoDice_profile *profile);
+void NoDice_profile_merge(struct NoDice_profile *dest, const struct NoDice_profile *src);
+int NoDice_profile_report(const struct NoDice_profile *profile, FILE *out, int csv);
+void NoDice_set_profile(struct NoDice_profile *profile);
+void NoDice_context_set_profile(struct NoDice_context *context, struct NoDice_profile *profile);
+
+// Whole-game decode; every level in game.xml (world maps included) is
+// loaded across a pool of worker threads, see NoDice_decode_all()
+struct NoDice_decode_result
+{
+	const struct NoDice_tileset *tileset;	// Tileset of the level
+	const struct NoDice_the_levels *level;	// Definition of the level
+	enum RUN6502_STOP_REASON stop;		// RUN6502_STOP_END if decoded, otherwise why not
+	char *error;						// Error message if stop is RUN6502_INIT_ERROR
+
+	struct NoDice_level decoded;		// The decoded level (if stop is RUN6502_STOP_END)
+	unsigned char tile_mem[0x2000];		// Copy of all 8K of MMC3 RAM, which decoded.tiles points to
+};
+struct NoDice_decode_result *NoDice_decode_all(int thread_count, struct NoDice_profile *profile, int *result_count);
+void NoDice_decode_free(struct NoDice_decode_result *results, int result_count);
+
+// PRG bank occupancy; see NoDice_get_bank_usage()
+struct NoDice_bank_range
+{
+	int bank;					// PRG bank (8KB)
+	unsigned short start, end;	// Offsets into the bank (end not included)
+	const struct NoDice_tileset *tileset;
+	const struct NoDice_the_levels *level;	// First level using the data
+	int is_objects;				// Object set rather than level layout
+};
+struct NoDice_bank_usage
+{
+	int free_space;				// Free (0xFF) bytes at the end of the bank
+	int range_count;
+	const struct NoDice_bank_range *ranges;	// Level data in the bank, by offset
+};
+const struct NoDice_bank_usage *NoDice_get_bank_usage(int *bank_count);
+
+// Checks every CHR decoder the CPU supports against the plain C one, over
+// all of CHR ROM and every plane byte pattern; 0 on any difference
+struct NoDice_chr_test
+{
+	int tiles;				// CHR ROM tiles checked
+	int version_count;
+	const char *versions[4];	// Decoders checked ("scalar" is the reference)
+};
+int NoDice_chr_test(struct NoDice_chr_test *test);
 const char *NoDice_config_game_add_level_entry(unsigned char tileset, const char *name, const char *layoutfile, const char *layoutlabel, const char *objectfile, const char *objectlabel, const char *desc);
 
+// Generated assembly is put together in memory, then written out
+// whole; see NoDice_emit_commit()
+struct NoDice_emit
+{
+	char *buf;
+	int len, alloc;
+	int failed;		// Ran out of memory; commit will fail
+	int binary;		// Raw bytes (see NoDice_emit_bytes), not text
+};
+void NoDice_emit_begin(struct NoDice_emit *emit);
+void NoDice_emit_str(struct NoDice_emit *emit, const char *str);
+void NoDice_emit_printf(struct NoDice_emit *emit, const char *format, ...);
+void NoDice_emit_hex8(struct NoDice_emit *emit, unsigned char value);
+void NoDice_emit_byte_rows(struct NoDice_emit *emit, const unsigned char *data, int size, int *col);
+void NoDice_emit_bytes(struct NoDice_emit *emit, const unsigned char *data, int size);
+enum NoDice_emit_result
+{
+	EMIT_FAILED,
+	EMIT_WRITTEN,
+	EMIT_UNCHANGED		// File already had the same text
+};
+int NoDice_emit_matches(const struct NoDice_emit *emit, const char *path);
+enum NoDice_emit_result NoDice_emit_commit(struct NoDice_emit *emit, const char *path);
+void NoDice_emit_free(struct NoDice_emit *emit);
+
 // Process execution
 #define EXEC_BUF_LINE_LEN	512	// Length of a single line of output from the process execution buffer
 int NoDice_exec_build(void (*buffer_callback)(const char *));	// FIXME: Probably not necessary to expose this
 const char *NoDice_DoBuild();
+int NoDice_build_needed();
+
+// Builds run in the background; see NoDice_build_start()
+enum NoDice_build_state
+{
+	BUILD_RUNNING,
+	BUILD_SUCCEEDED,
+	BUILD_FAILED,
+	BUILD_CANCELLED
+};
+struct NoDice_build;
+struct NoDice_build *NoDice_build_start();
+int NoDice_build_next_line(struct NoDice_build *build, char *line, int size);
+enum NoDice_build_state NoDice_build_state(struct NoDice_build *build);
+void NoDice_build_cancel(struct NoDice_build *build);
+enum NoDice_build_state NoDice_build_wait(struct NoDice_build *build);
+const char *NoDice_build_log(struct NoDice_build *build);
+void NoDice_build_destroy(struct NoDice_build *build);
 
 #endif // _NODICELIB_H
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "NoDiceLib.h"
+#include "internal.h"
+
+#define BANK_SIZE		8192
+#define LAYOUT_WINDOW	0xA000	// Level layouts are read with their bank at A000
+#define OBJECT_WINDOW	0xC000	// and objects with OBJ_BANK at C000
+
+// The occupancy index; built on first use after the PRG is loaded and
+// thrown out when a refresh changes any bank (see _banks_free)
+static struct NoDice_bank_usage *banks_usage = NULL;
+static struct NoDice_bank_range *banks_ranges = NULL;
+static int banks_count = 0;
+
+
+static int banks_range_compare(const void *a, const void *b)
+{
+	const struct NoDice_bank_range *ra = (const struct NoDice_bank_range *)a, *rb = (const struct NoDice_bank_range *)b;
+
+	if(ra->bank != rb->bank)
+		return ra->bank - rb->bank;
+
+	if(ra->start != rb->start)
+		return ra->start - rb->start;
+
+	return ra->is_objects - rb->is_objects;
+}
+
+
+// Adds a range unless the same data is already in (levels may share a
+// layout or object set); returns 0 if out of memory
+static int banks_range_add(struct NoDice_bank_range **ranges, int *count, int *alloc, const struct NoDice_decode_result *result, int bank, unsigned short addr, int size, int is_objects)
+{
+	struct NoDice_bank_range *range;
+	int start = addr - (is_objects ? OBJECT_WINDOW : LAYOUT_WINDOW), i;
+
+	if(bank < 0 || bank >= banks_count || start < 0 || start + size > BANK_SIZE)
+		return 1;
+
+	for(i = 0; i < *count; i++)
+	{
+		if((*ranges)[i].bank == bank && (*ranges)[i].start == start && (*ranges)[i].is_objects == is_objects)
+			return 1;
+	}
+
+	if(*count == *alloc)
+	{
+		int grown_alloc = (*alloc > 0) ? *alloc * 2 : 128;
+
+		if( (range = (struct NoDice_bank_range *)realloc(*ranges, grown_alloc * sizeof(struct NoDice_bank_range))) == NULL)
+			return 0;
+
+		*ranges = range;
+		*alloc = grown_alloc;
+	}
+
+	range = &(*ranges)[(*count)++];
+	range->bank = bank;
+	range->start = start;
+	range->end = range->start + size;
+	range->tileset = result->tileset;
+	range->level = result->level;
+	range->is_objects = is_objects;
+
+	return 1;
+}
+
+
+// Returns the occupancy of every PRG bank (count in bank_count): the
+// free space at the end of each and where every level's layout and
+// object set is, going by the FNS labels and the levels as loaded.
+// World maps are not included.  Every level is decoded the first time
+// this is called after the PRG is loaded or changes, which takes a
+// moment.  Valid until the next PRG refresh; NULL on failure (see
+// NoDice_Error()), including a level which fails to load.
+const struct NoDice_bank_usage *NoDice_get_bank_usage(int *bank_count)
+{
+	struct NoDice_decode_result *results;
+	struct NoDice_bank_range *ranges = NULL;
+	int result_count, range_count = 0, range_alloc = 0, i;
+
+	*bank_count = 0;
+
+	if(banks_usage != NULL)
+	{
+		*bank_count = banks_count;
+		return banks_usage;
+	}
+
+	banks_count = NoDice_PRG_bank_count();
+
+	// Layout sizes are only known by running the level loader
+	if( (results = NoDice_decode_all(0, NULL, &result_count)) == NULL)
+		return NULL;
+
+	for(i = 0; i < result_count; i++)
+	{
+		const struct NoDice_decode_result *result = &results[i];
+		const struct NoDice_level *level = &result->decoded;
+		unsigned short object_addr;
+
+		if(result->tileset->id == 0)
+			continue;
+
+		if(result->stop != RUN6502_STOP_END)
+		{
+			snprintf(_error_msg, ERROR_MSG_LEN, "%s: %s failed to load: %s", result->tileset->name, result->level->name, NoDice_stop_reason_string(result->stop));
+			NoDice_decode_free(results, result_count);
+			free(ranges);
+			return NULL;
+		}
+
+		// Layout runs from its label (header first) to the 0xFF the loader stopped on
+		if(!banks_range_add(&ranges, &range_count, &range_alloc, result, NoDice_get_tileset_bank(result->tileset->id), level->addr_start, level->addr_end - level->addr_start + 1, 0))
+			break;
+
+		// Objects are the unknown byte, 3 bytes each and the 0xFF terminator
+		if(result->level->objectlabel != NULL && (object_addr = NoDice_get_addr_for_label(result->level->objectlabel)) != 0xFFFF)
+		{
+			if(!banks_range_add(&ranges, &range_count, &range_alloc, result, OBJ_BANK, object_addr, 1 + level->object_count * 3 + 1, 1))
+				break;
+		}
+	}
+
+	NoDice_decode_free(results, result_count);
+
+	if(i < result_count || (banks_usage = (struct NoDice_bank_usage *)calloc(banks_count > 0 ? banks_count : 1, sizeof(struct NoDice_bank_usage))) == NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to allocate bank occupancy index");
+		free(ranges);
+		return NULL;
+	}
+
+	if(range_count > 0)
+		qsort(ranges, range_count, sizeof(struct NoDice_bank_range), banks_range_compare);
+
+	banks_ranges = ranges;
+
+	for(i = 0; i < banks_count; i++)
+		banks_usage[i].free_space = _rom_PRG_bank_free_space(i);
+
+	for(i = 0; i < range_count; i++)
+	{
+		struct NoDice_bank_usage *usage = &banks_usage[ranges[i].bank];
+
+		if(usage->range_count++ == 0)
+			usage->ranges = &ranges[i];
+	}
+
+	*bank_count = banks_count;
+	return banks_usage;
+}
+
+
+void _banks_free()
+{
+	free(banks_usage);
+	free(banks_ranges);
+
+	banks_usage = NULL;
+	banks_ranges = NULL;
+	banks_count = 0;
+}
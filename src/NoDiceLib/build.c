@@ -0,0 +1,208 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "NoDiceLib.h"
+#include "internal.h"
+
+// An assembler run on its own thread; the output piles up in log, and
+// NoDice_build_next_line hands it out a line at a time as it arrives
+struct NoDice_build
+{
+	_thread_t thread;
+	struct _exec_process process;
+
+	_mutex_t lock;		// Guards everything below
+	char *log;			// All output so far (always terminated)
+	int log_len, log_alloc;
+	int log_read;		// Output handed out by NoDice_build_next_line so far
+	enum NoDice_build_state state;
+};
+
+
+static void build_output(void *user, const char *text)
+{
+	struct NoDice_build *build = (struct NoDice_build *)user;
+	int len = strlen(text);
+
+	_mutex_lock(build->lock);
+
+	if(build->log_len + len + 1 > build->log_alloc)
+	{
+		int alloc = build->log_alloc * 2;
+		char *log;
+
+		while(build->log_len + len + 1 > alloc)
+			alloc *= 2;
+
+		// Short on memory, the rest of the output is dropped
+		if( (log = (char *)realloc(build->log, alloc)) == NULL)
+		{
+			_mutex_unlock(build->lock);
+			return;
+		}
+
+		build->log = log;
+		build->log_alloc = alloc;
+	}
+
+	memcpy(&build->log[build->log_len], text, len + 1);
+	build->log_len += len;
+
+	_mutex_unlock(build->lock);
+}
+
+
+static void build_thread(void *arg)
+{
+	struct NoDice_build *build = (struct NoDice_build *)arg;
+	int result = _exec_build(build_output, build, &build->process), cancelled;
+
+	_mutex_lock(build->process.lock);
+	cancelled = build->process.cancelled;
+	_mutex_unlock(build->process.lock);
+
+	_mutex_lock(build->lock);
+	build->state = cancelled ? BUILD_CANCELLED : result ? BUILD_SUCCEEDED : BUILD_FAILED;
+	_mutex_unlock(build->lock);
+}
+
+
+// Starts the configured build on its own thread; follow it with
+// NoDice_build_next_line() and NoDice_build_state(), and release it
+// with NoDice_build_destroy().  Returns NULL on failure.
+struct NoDice_build *NoDice_build_start()
+{
+	struct NoDice_build *build = (struct NoDice_build *)calloc(1, sizeof(struct NoDice_build));
+
+	if(build == NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to allocate build");
+		return NULL;
+	}
+
+	build->log_alloc = 4096;
+	build->state = BUILD_RUNNING;
+
+	if( (build->log = (char *)malloc(build->log_alloc)) == NULL ||
+		(build->lock = _mutex_create()) == NULL ||
+		(build->process.lock = _mutex_create()) == NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to allocate build");
+		NoDice_build_destroy(build);
+		return NULL;
+	}
+
+	build->log[0] = '\0';
+
+	// Couldn't get a thread, so just do it here
+	if( (build->thread = _thread_create(build_thread, build)) == NULL)
+		build_thread(build);
+
+	return build;
+}
+
+
+// Copies the next line of output (without its line break) into line,
+// cut short to fit size; returns 0 if no whole line is waiting.  Once
+// the build is over, whatever is left makes the last line.
+int NoDice_build_next_line(struct NoDice_build *build, char *line, int size)
+{
+	const char *start, *end;
+	int len, next;
+
+	_mutex_lock(build->lock);
+
+	start = &build->log[build->log_read];
+
+	if( (end = strchr(start, '\n')) != NULL)
+		next = (int)(end - build->log) + 1;
+	else if(build->state != BUILD_RUNNING && *start != '\0')
+	{
+		end = &build->log[build->log_len];
+		next = build->log_len;
+	}
+	else
+	{
+		_mutex_unlock(build->lock);
+		return 0;
+	}
+
+	if(end > start && end[-1] == '\r')
+		end--;
+
+	len = (int)(end - start);
+	if(len > size - 1)
+		len = size - 1;
+
+	memcpy(line, start, len);
+	line[len] = '\0';
+
+	build->log_read = next;
+
+	_mutex_unlock(build->lock);
+
+	return 1;
+}
+
+
+enum NoDice_build_state NoDice_build_state(struct NoDice_build *build)
+{
+	enum NoDice_build_state state;
+
+	_mutex_lock(build->lock);
+	state = build->state;
+	_mutex_unlock(build->lock);
+
+	return state;
+}
+
+
+// Stops the build; NoDice_build_state() says BUILD_CANCELLED once it has
+void NoDice_build_cancel(struct NoDice_build *build)
+{
+	_exec_cancel(&build->process);
+}
+
+
+// Waits for the build to be over and returns how it went
+enum NoDice_build_state NoDice_build_wait(struct NoDice_build *build)
+{
+	if(build->thread != NULL)
+	{
+		_thread_join(build->thread);
+		build->thread = NULL;
+	}
+
+	return build->state;
+}
+
+
+// All of the build's output; only to be used once the build is over
+// (see NoDice_build_wait)
+const char *NoDice_build_log(struct NoDice_build *build)
+{
+	return build->log;
+}
+
+
+// Cancels the build if it is still going
+void NoDice_build_destroy(struct NoDice_build *build)
+{
+	if(build == NULL)
+		return;
+
+	if(build->thread != NULL)
+	{
+		NoDice_build_cancel(build);
+		NoDice_build_wait(build);
+	}
+
+	if(build->process.lock != NULL)
+		_mutex_destroy(build->process.lock);
+
+	if(build->lock != NULL)
+		_mutex_destroy(build->lock);
+
+	free(build->log);
+	free(build);
+}
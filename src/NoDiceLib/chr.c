@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "NoDiceLib.h"
+#include "internal.h"
+
+// Planar to linear CHR decoding.  The NES stores each 8x8 tile as two
+// 8 byte bit planes (16 bytes); decoded, it's one byte per pixel (64
+// bytes) holding the 2-bit color.  _chr_decode picks the widest of the
+// versions below the CPU supports the first time it's used; _chr_test
+// checks each one the CPU supports against the scalar version.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CHR_SSE2
+#include <emmintrin.h>
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CHR_AVX2
+#include <immintrin.h>
+#endif
+
+
+static void chr_decode_scalar(const unsigned char *planar, unsigned char *linear, int tiles)
+{
+	int tile, row;
+
+	for(tile = 0; tile < tiles; tile++, planar += 16)
+	{
+		// Break down all 8 rows
+		for(row = 0; row < 8; row++)
+		{
+			unsigned char a = planar[ row ];
+			unsigned char b = planar[ row + 8];
+
+			*linear++ = ((a >> 7) & 1) | ((b >> 6) & 2);
+			*linear++ = ((a >> 6) & 1) | ((b >> 5) & 2);
+			*linear++ = ((a >> 5) & 1) | ((b >> 4) & 2);
+			*linear++ = ((a >> 4) & 1) | ((b >> 3) & 2);
+			*linear++ = ((a >> 3) & 1) | ((b >> 2) & 2);
+			*linear++ = ((a >> 2) & 1) | ((b >> 1) & 2);
+			*linear++ = ((a >> 1) & 1) | ((b     ) & 2);
+			*linear++ = ((a     ) & 1) | ((b << 1) & 2);
+		}
+	}
+}
+
+
+#ifdef CHR_SSE2
+
+// Two tiles at a time: every plane byte is spread across 8 bytes, then
+// each byte keeps only the bit for its pixel
+static void chr_decode_sse2(const unsigned char *planar, unsigned char *linear, int tiles)
+{
+	const __m128i bits = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128);
+	const __m128i one = _mm_set1_epi8(1), two = _mm_set1_epi8(2);
+	int pair;
+
+	for(pair = 0; pair < tiles / 2; pair++, planar += 32, linear += 128)
+	{
+		__m128i t0 = _mm_loadu_si128((const __m128i *)planar);
+		__m128i t1 = _mm_loadu_si128((const __m128i *)(planar + 16));
+
+		// Low planes of both tiles, high planes of both tiles
+		__m128i a = _mm_unpacklo_epi64(t0, t1), b = _mm_unpackhi_epi64(t0, t1);
+		__m128i a8[2], b8[2], a16[4], b16[4];
+		int i;
+
+		a8[0] = _mm_unpacklo_epi8(a, a);		a8[1] = _mm_unpackhi_epi8(a, a);
+		b8[0] = _mm_unpacklo_epi8(b, b);		b8[1] = _mm_unpackhi_epi8(b, b);
+
+		for(i = 0; i < 2; i++)
+		{
+			a16[i * 2 + 0] = _mm_unpacklo_epi16(a8[i], a8[i]);	a16[i * 2 + 1] = _mm_unpackhi_epi16(a8[i], a8[i]);
+			b16[i * 2 + 0] = _mm_unpacklo_epi16(b8[i], b8[i]);	b16[i * 2 + 1] = _mm_unpackhi_epi16(b8[i], b8[i]);
+		}
+
+		// Each quarter now makes two rows of 8 pixels
+		for(i = 0; i < 8; i++)
+		{
+			__m128i ra = (i & 1) ? _mm_unpackhi_epi32(a16[i / 2], a16[i / 2]) : _mm_unpacklo_epi32(a16[i / 2], a16[i / 2]);
+			__m128i rb = (i & 1) ? _mm_unpackhi_epi32(b16[i / 2], b16[i / 2]) : _mm_unpacklo_epi32(b16[i / 2], b16[i / 2]);
+
+			ra = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(ra, bits), bits), one);
+			rb = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(rb, bits), bits), two);
+
+			_mm_storeu_si128((__m128i *)(linear + i * 16), _mm_or_si128(ra, rb));
+		}
+	}
+
+	chr_decode_scalar(planar, linear, tiles & 1);
+}
+
+#endif
+
+
+#ifdef CHR_AVX2
+
+// Same as the SSE2 version, four tiles at a time: tiles 0 and 1 in the
+// low half of each register and tiles 2 and 3 in the high half
+__attribute__((target("avx2")))
+static void chr_decode_avx2(const unsigned char *planar, unsigned char *linear, int tiles)
+{
+	const __m256i bits = _mm256_set_epi8(
+		1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128,
+		1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128);
+	const __m256i one = _mm256_set1_epi8(1), two = _mm256_set1_epi8(2);
+	int quad;
+
+	for(quad = 0; quad < tiles / 4; quad++, planar += 64, linear += 256)
+	{
+		__m256i t01 = _mm256_loadu_si256((const __m256i *)planar);
+		__m256i t23 = _mm256_loadu_si256((const __m256i *)(planar + 32));
+		__m256i t02 = _mm256_permute2x128_si256(t01, t23, 0x20), t13 = _mm256_permute2x128_si256(t01, t23, 0x31);
+		__m256i a = _mm256_unpacklo_epi64(t02, t13), b = _mm256_unpackhi_epi64(t02, t13);
+		__m256i a8[2], b8[2], a16[4], b16[4], rows[8];
+		int i;
+
+		a8[0] = _mm256_unpacklo_epi8(a, a);		a8[1] = _mm256_unpackhi_epi8(a, a);
+		b8[0] = _mm256_unpacklo_epi8(b, b);		b8[1] = _mm256_unpackhi_epi8(b, b);
+
+		for(i = 0; i < 2; i++)
+		{
+			a16[i * 2 + 0] = _mm256_unpacklo_epi16(a8[i], a8[i]);	a16[i * 2 + 1] = _mm256_unpackhi_epi16(a8[i], a8[i]);
+			b16[i * 2 + 0] = _mm256_unpacklo_epi16(b8[i], b8[i]);	b16[i * 2 + 1] = _mm256_unpackhi_epi16(b8[i], b8[i]);
+		}
+
+		for(i = 0; i < 8; i++)
+		{
+			__m256i ra = (i & 1) ? _mm256_unpackhi_epi32(a16[i / 2], a16[i / 2]) : _mm256_unpacklo_epi32(a16[i / 2], a16[i / 2]);
+			__m256i rb = (i & 1) ? _mm256_unpackhi_epi32(b16[i / 2], b16[i / 2]) : _mm256_unpacklo_epi32(b16[i / 2], b16[i / 2]);
+
+			ra = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(ra, bits), bits), one);
+			rb = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(rb, bits), bits), two);
+
+			rows[i] = _mm256_or_si256(ra, rb);
+		}
+
+		// Low halves belong to tiles 0 and 1, high halves to tiles 2 and 3
+		for(i = 0; i < 8; i += 2)
+		{
+			_mm256_storeu_si256((__m256i *)(linear + i * 16), _mm256_permute2x128_si256(rows[i], rows[i + 1], 0x20));
+			_mm256_storeu_si256((__m256i *)(linear + 128 + i * 16), _mm256_permute2x128_si256(rows[i], rows[i + 1], 0x31));
+		}
+	}
+
+	chr_decode_scalar(planar, linear, tiles & 3);
+}
+
+#endif
+
+
+typedef void (*chr_decoder_t)(const unsigned char *planar, unsigned char *linear, int tiles);
+
+static int chr_always()
+{
+	return 1;
+}
+
+#ifdef CHR_AVX2
+static int chr_has_avx2()
+{
+	return __builtin_cpu_supports("avx2");
+}
+#endif
+
+// Every version built in, narrowest first; the last one the CPU supports
+// is used
+static const struct chr_version
+{
+	const char *name;
+	chr_decoder_t decode;
+	int (*supported)();
+} chr_versions[] =
+{
+	{ "scalar", chr_decode_scalar, chr_always },
+#ifdef CHR_SSE2
+	{ "SSE2", chr_decode_sse2, chr_always },
+#endif
+#ifdef CHR_AVX2
+	{ "AVX2", chr_decode_avx2, chr_has_avx2 },
+#endif
+};
+#define CHR_VERSION_COUNT	(int)(sizeof(chr_versions) / sizeof(chr_versions[0]))
+
+static chr_decoder_t chr_decoder = NULL;
+
+// Decodes tiles from planar (16 bytes each) to linear (64 bytes each)
+void _chr_decode(const unsigned char *planar, unsigned char *linear, int tiles)
+{
+	// Choosing is harmless to repeat, so there's no need to lock
+	if(chr_decoder == NULL)
+	{
+		chr_decoder_t decoder = chr_decode_scalar;
+		int i;
+
+		for(i = 1; i < CHR_VERSION_COUNT; i++)
+			if(chr_versions[i].supported())
+				decoder = chr_versions[i].decode;
+
+		chr_decoder = decoder;
+	}
+
+	chr_decoder(planar, linear, tiles);
+}
+
+
+// Runs one version against the scalar one over the given tiles; 0 (with
+// the error set) if the output differs, or it writes past the end
+static int chr_test_run(const struct chr_version *version, const unsigned char *planar, int tiles, unsigned char *want, unsigned char *got)
+{
+	int i;
+
+	chr_decode_scalar(planar, want, tiles);
+
+	// Bytes past the last tile must be left alone
+	memset(got, 0xA5, (tiles + 4) * 64);
+	version->decode(planar, got, tiles);
+
+	for(i = 0; i < (tiles + 4) * 64; i++)
+	{
+		int expect = (i < tiles * 64) ? want[i] : 0xA5;
+
+		if(got[i] != expect)
+		{
+			snprintf(_error_msg, ERROR_MSG_LEN, "%s CHR decode of %i tiles differs at tile %i pixel %i (got %i, expected %i)", version->name, tiles, i / 64, i % 64, got[i], expect);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+int _chr_test(const unsigned char *CHR, int CHR_tiles, struct NoDice_chr_test *test)
+{
+	// Every combination of the two plane bytes of a row, 8 rows a tile
+	const int pattern_tiles = 256 * 256 / 8;
+	unsigned char *pattern, *want, *got;
+	int i, ok = 1, max_tiles = (CHR_tiles > pattern_tiles) ? CHR_tiles : pattern_tiles;
+
+	memset(test, 0, sizeof(struct NoDice_chr_test));
+
+	pattern = (unsigned char *)malloc(pattern_tiles * 16);
+	want = (unsigned char *)malloc((max_tiles + 4) * 64);
+	got = (unsigned char *)malloc((max_tiles + 4) * 64);
+
+	if(pattern == NULL || want == NULL || got == NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Out of memory for the CHR decode test");
+		ok = 0;
+	}
+	else
+	{
+		for(i = 0; i < 256 * 256; i++)
+		{
+			pattern[(i / 8) * 16 + (i % 8)] = i & 0xFF;
+			pattern[(i / 8) * 16 + (i % 8) + 8] = i >> 8;
+		}
+
+		for(i = 0; i < CHR_VERSION_COUNT && ok; i++)
+		{
+			const struct chr_version *version = &chr_versions[i];
+			int tiles, start;
+
+			if(!version->supported())
+				continue;
+
+			test->versions[test->version_count++] = version->name;
+
+			// Whole of CHR ROM and the pattern, then short and odd counts
+			// from a few starting tiles so every leftover path is run
+			ok = chr_test_run(version, CHR, CHR_tiles, want, got) &&
+				chr_test_run(version, pattern, pattern_tiles, want, got);
+
+			for(start = 0; start < 3 && ok; start++)
+				for(tiles = 0; tiles <= 9 && ok; tiles++)
+					ok = chr_test_run(version, pattern + start * 16 * 37, tiles, want, got);
+
+			if(ok && CHR_tiles > 1)
+				ok = chr_test_run(version, CHR + 16, CHR_tiles - 1, want, got);
+		}
+
+		test->tiles = CHR_tiles;
+	}
+
+	free(pattern);
+	free(want);
+	free(got);
+
+	return ok;
+}
@@ -15,6 +15,10 @@
 #define CONFIG_XML	"config.xml"
 #define GAME_XML	"game.xml"
 
+#define CORE_BUDGET_DEFAULT	100000000	// 6502 cycles if config.xml doesn't give a corebudget
+#define UNDO_BUDGET_DEFAULT	1048576		// Bytes if config.xml doesn't give an undobudget
+#define UNDO_BUDGET_MIN		65536		// Least undobudget taken (several whole states of the largest level)
+
 static ezxml_t config_xml, game_xml;
 struct NoDice_configuration NoDice_config;
 
@@ -391,10 +395,27 @@ int _config_init()
 
 
 	{
-		const char *core6502_timeout;
-		if((core6502_timeout = ezxml_attr(required_child(config_xml, "coretimeout"), "value")) == NULL)
-			return 0;
-		NoDice_config.core6502_timeout = strtoul(core6502_timeout, NULL, 0);
+		// Optional; without it, the startup build is skipped when the ROM
+		// and FNS are newer than every source file
+		const char *force_build = ezxml_attr(ezxml_child(config_xml, "forcebuild"), "value");
+		NoDice_config.buildinfo.force = (force_build != NULL) && (!strcasecmp(force_build, "true") || !strcasecmp(force_build, "yes") || atoi(force_build) != 0);
+	}
+
+
+	{
+		// Optional; older config.xml files have a (wall clock) coretimeout
+		// instead, which is no longer used
+		const char *core6502_budget = ezxml_attr(ezxml_child(config_xml, "corebudget"), "value");
+		NoDice_config.core6502_budget = (core6502_budget != NULL) ? strtoul(core6502_budget, NULL, 0) : CORE_BUDGET_DEFAULT;
+	}
+
+	{
+		// Optional
+		const char *undo_budget = ezxml_attr(ezxml_child(config_xml, "undobudget"), "value");
+		NoDice_config.undo_budget = (undo_budget != NULL) ? strtoul(undo_budget, NULL, 0) : UNDO_BUDGET_DEFAULT;
+
+		if(NoDice_config.undo_budget < UNDO_BUDGET_MIN)
+			NoDice_config.undo_budget = UNDO_BUDGET_MIN;
 	}
 
 	{
@@ -429,6 +450,7 @@ int _config_init()
 			NoDice_config.game.options.title = "Untitled Game";
 			NoDice_config.game.options.warpzone = "9";
 			NoDice_config.game.options.object_set_bank = "prg006";
+			NoDice_config.game.options.layout_incbin = 0;
 
 			// Iterate children...
 			for(node = ezxml_child(game_node, "configitem"); node != NULL; node = ezxml_next(node))
@@ -449,6 +471,11 @@ int _config_init()
 					{
 						NoDice_config.game.options.object_set_bank = value;
 					}
+					else if(!strcasecmp(name, "layoutformat"))
+					{
+						// "binary" or "text" (the default)
+						NoDice_config.game.options.layout_incbin = !strcasecmp(value, "binary");
+					}
 				}
 			}
 		}
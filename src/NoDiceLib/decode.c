@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "NoDiceLib.h"
+#include "internal.h"
+
+struct decode_pool;
+
+// One worker thread and the context it decodes on
+struct decode_worker
+{
+	struct decode_pool *pool;
+	struct NoDice_context *context;
+	struct NoDice_profile *profile;	// Worker's own profile (if profiling)
+	_thread_t thread;
+};
+
+// Shared by all workers; everything here is guarded by lock
+struct decode_pool
+{
+	_mutex_t lock;
+	struct NoDice_decode_result *results;
+	int result_count;
+	int next;		// Index of next result to be decoded
+};
+
+
+// Copies the level the context just loaded into the result so it
+// survives the context loading something else
+static int decode_keep_level(const struct NoDice_level *level, struct NoDice_decode_result *result)
+{
+	const struct NoDice_the_level_generator *cur;
+	struct NoDice_the_level_generator *copy;
+	int count = 0, i;
+
+	result->decoded = *level;
+	result->decoded.level = result->level;
+	result->decoded.generators = NULL;
+
+	// Tile RAM belongs to the context; keep our own
+	memcpy(result->tile_mem, level->tiles, sizeof(result->tile_mem));
+	result->decoded.tiles = result->tile_mem;
+
+	// As does the generator list; the copy is one block, in list order
+	for(cur = level->generators; cur != NULL; cur = cur->next)
+		count++;
+
+	if(count == 0)
+		return 1;
+
+	if( (copy = (struct NoDice_the_level_generator *)malloc(count * sizeof(struct NoDice_the_level_generator))) == NULL)
+		return 0;
+
+	for(cur = level->generators, i = 0; cur != NULL; cur = cur->next, i++)
+	{
+		copy[i] = *cur;
+		copy[i].prev = (i > 0) ? &copy[i - 1] : NULL;
+		copy[i].next = (i < count - 1) ? &copy[i + 1] : NULL;
+	}
+
+	result->decoded.generators = copy;
+
+	return 1;
+}
+
+
+static void decode_one(struct NoDice_context *context, struct NoDice_decode_result *result)
+{
+	NoDice_context_load_level(context, result->tileset->id, result->level->layoutlabel, result->level->objectlabel);
+	result->stop = NoDice_context_stop_reason(context);
+
+	if(result->stop == RUN6502_STOP_END)
+	{
+		if(!decode_keep_level(NoDice_context_level(context), result))
+		{
+			snprintf(_error_msg, ERROR_MSG_LEN, "Out of memory keeping decoded level");
+			result->stop = RUN6502_INIT_ERROR;
+		}
+	}
+
+	if(result->stop == RUN6502_INIT_ERROR)
+		result->error = strdup(_error_msg);
+}
+
+
+static void decode_worker_thread(void *arg)
+{
+	struct decode_worker *worker = (struct decode_worker *)arg;
+	struct decode_pool *pool = worker->pool;
+	int index;
+
+	for(;;)
+	{
+		// Take the next level nobody has started yet
+		_mutex_lock(pool->lock);
+		index = pool->next;
+		if(index < pool->result_count)
+			pool->next++;
+		_mutex_unlock(pool->lock);
+
+		if(index >= pool->result_count)
+			break;
+
+		// A frozen level is stopped by the context's own cycle budget
+		decode_one(worker->context, &pool->results[index]);
+	}
+}
+
+
+// Decodes every level of every tileset (world maps included) from
+// game.xml across thread_count worker threads (<= 0 to use one per
+// CPU), each running its own context.  Returns the results in game.xml
+// order and their count in result_count, or NULL on failure (see
+// NoDice_Error()).  Release with NoDice_decode_free().  If profile is
+// given, what every worker ran is added into it.
+struct NoDice_decode_result *NoDice_decode_all(int thread_count, struct NoDice_profile *profile, int *result_count)
+{
+	struct decode_pool pool;
+	struct decode_worker *workers;
+	int i, j, started;
+
+	*result_count = 0;
+
+	// Lay out a result for every level
+	pool.result_count = 0;
+	for(i = 0; i < NoDice_config.game.tileset_count; i++)
+		pool.result_count += NoDice_config.game.tilesets[i].levels_count;
+
+	if( (pool.results = (struct NoDice_decode_result *)calloc(pool.result_count > 0 ? pool.result_count : 1, sizeof(struct NoDice_decode_result))) == NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to allocate decode results");
+		return NULL;
+	}
+
+	for(i = 0, j = 0; i < NoDice_config.game.tileset_count; i++)
+	{
+		const struct NoDice_tileset *tileset = &NoDice_config.game.tilesets[i];
+		int l;
+
+		for(l = 0; l < tileset->levels_count; l++, j++)
+		{
+			pool.results[j].tileset = tileset;
+			pool.results[j].level = &tileset->levels[l];
+			pool.results[j].stop = RUN6502_STOP_NOTSTOPPED;
+		}
+	}
+
+	if(thread_count <= 0)
+		thread_count = _thread_cpu_count();
+
+	if(thread_count > pool.result_count)
+		thread_count = pool.result_count;
+
+	if(thread_count == 0)
+		return pool.results;
+
+	if( (workers = (struct decode_worker *)calloc(thread_count, sizeof(struct decode_worker))) == NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to allocate decode workers");
+		free(pool.results);
+		return NULL;
+	}
+
+	if( (pool.lock = _mutex_create()) == NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to create decode lock");
+		free(workers);
+		free(pool.results);
+		return NULL;
+	}
+
+	pool.next = 0;
+
+	// Contexts are created up front so a failure doesn't leave work undone
+	for(i = 0; i < thread_count; i++)
+	{
+		workers[i].pool = &pool;
+
+		if( (workers[i].context = NoDice_context_create()) == NULL ||
+			(profile != NULL && (workers[i].profile = NoDice_profile_create()) == NULL))
+		{
+			NoDice_context_destroy(workers[i].context);
+			while(i-- > 0)
+			{
+				NoDice_context_destroy(workers[i].context);
+				NoDice_profile_destroy(workers[i].profile);
+			}
+
+			_mutex_destroy(pool.lock);
+			free(workers);
+			free(pool.results);
+			return NULL;
+		}
+
+		NoDice_context_set_profile(workers[i].context, workers[i].profile);
+	}
+
+	// Start the workers; as long as one gets going the work all gets done
+	for(i = 0, started = 0; i < thread_count; i++)
+	{
+		if( (workers[i].thread = _thread_create(decode_worker_thread, &workers[i])) != NULL)
+			started++;
+	}
+
+	// Couldn't get any threads, so just do it here
+	if(started == 0)
+		decode_worker_thread(&workers[0]);
+
+	for(i = 0; i < thread_count; i++)
+	{
+		if(workers[i].thread != NULL)
+			_thread_join(workers[i].thread);
+
+		NoDice_context_destroy(workers[i].context);
+
+		if(workers[i].profile != NULL)
+		{
+			NoDice_profile_merge(profile, workers[i].profile);
+			NoDice_profile_destroy(workers[i].profile);
+		}
+	}
+
+	_mutex_destroy(pool.lock);
+	free(workers);
+
+	*result_count = pool.result_count;
+	return pool.results;
+}
+
+
+void NoDice_decode_free(struct NoDice_decode_result *results, int result_count)
+{
+	int i;
+
+	if(results == NULL)
+		return;
+
+	for(i = 0; i < result_count; i++)
+	{
+		// Generators were kept as one block (see decode_keep_level)
+		free(results[i].decoded.generators);
+		free(results[i].error);
+	}
+
+	free(results);
+}
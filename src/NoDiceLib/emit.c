@@ -0,0 +1,256 @@
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "NoDiceLib.h"
+#include "internal.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#define EMIT_ALLOC_START	4096
+
+static const char emit_hex[] = "0123456789ABCDEF";
+
+
+// Makes room for len more characters (plus terminator); returns 0 if
+// out of memory, after which everything else emitted is dropped
+static int emit_reserve(struct NoDice_emit *emit, int len)
+{
+	if(emit->failed)
+		return 0;
+
+	if(emit->len + len + 1 > emit->alloc)
+	{
+		int alloc = (emit->alloc > 0) ? emit->alloc : EMIT_ALLOC_START;
+		char *buf;
+
+		while(emit->len + len + 1 > alloc)
+			alloc *= 2;
+
+		if( (buf = (char *)realloc(emit->buf, alloc)) == NULL)
+		{
+			emit->failed = 1;
+			return 0;
+		}
+
+		emit->buf = buf;
+		emit->alloc = alloc;
+	}
+
+	return 1;
+}
+
+
+// Starts a new file's worth of output
+void NoDice_emit_begin(struct NoDice_emit *emit)
+{
+	memset(emit, 0, sizeof(struct NoDice_emit));
+}
+
+
+void NoDice_emit_str(struct NoDice_emit *emit, const char *str)
+{
+	int len = strlen(str);
+
+	if(!emit_reserve(emit, len))
+		return;
+
+	memcpy(&emit->buf[emit->len], str, len + 1);
+	emit->len += len;
+}
+
+
+void NoDice_emit_printf(struct NoDice_emit *emit, const char *format, ...)
+{
+	va_list args;
+	int len;
+
+	if(!emit_reserve(emit, 256))
+		return;
+
+	va_start(args, format);
+	len = vsnprintf(&emit->buf[emit->len], emit->alloc - emit->len, format, args);
+	va_end(args);
+
+	// Didn't fit; make room for all of it and go again
+	if(len >= emit->alloc - emit->len)
+	{
+		if(!emit_reserve(emit, len))
+			return;
+
+		va_start(args, format);
+		len = vsnprintf(&emit->buf[emit->len], emit->alloc - emit->len, format, args);
+		va_end(args);
+	}
+
+	if(len < 0)
+	{
+		emit->buf[emit->len] = '\0';
+		return;
+	}
+
+	emit->len += len;
+}
+
+
+// Emits value as $XX
+void NoDice_emit_hex8(struct NoDice_emit *emit, unsigned char value)
+{
+	char *p;
+
+	if(!emit_reserve(emit, 3))
+		return;
+
+	p = &emit->buf[emit->len];
+	p[0] = '$';
+	p[1] = emit_hex[value >> 4];
+	p[2] = emit_hex[value & 0x0F];
+	p[3] = '\0';
+
+	emit->len += 3;
+}
+
+
+// Emits data as ".byte $XX, $XX, ..." rows of 16; *col is where the
+// current row is up to, so a row can carry on over several calls
+void NoDice_emit_byte_rows(struct NoDice_emit *emit, const unsigned char *data, int size, int *col)
+{
+	int i;
+
+	for(i = 0; i < size; i++)
+	{
+		if(*col == 0)
+			NoDice_emit_str(emit, "\n\t.byte ");
+
+		NoDice_emit_hex8(emit, data[i]);
+
+		if(++(*col) == 16)
+			*col = 0;
+		else if(i < (size-1))
+			NoDice_emit_str(emit, ", ");
+	}
+}
+
+
+// Emits data as it is, which makes this a binary file
+void NoDice_emit_bytes(struct NoDice_emit *emit, const unsigned char *data, int size)
+{
+	emit->binary = 1;
+
+	if(!emit_reserve(emit, size))
+		return;
+
+	memcpy(&emit->buf[emit->len], data, size);
+	emit->len += size;
+	emit->buf[emit->len] = '\0';
+}
+
+
+// Returns 1 if path already holds exactly what was emitted
+int NoDice_emit_matches(const struct NoDice_emit *emit, const char *path)
+{
+	char chunk[4096];
+	FILE *file;
+	int offset = 0, read_amt, result = 1;
+
+	// Read the same way it's written, so line endings compare equal
+	if( (file = fopen(path, emit->binary ? "rb" : "r")) == NULL)
+		return 0;
+
+	while(result && (read_amt = (int)fread(chunk, 1, sizeof(chunk), file)) > 0)
+	{
+		if(offset + read_amt > emit->len || memcmp(chunk, &emit->buf[offset], read_amt))
+			result = 0;
+
+		offset += read_amt;
+	}
+
+	if(ferror(file) || offset != emit->len)
+		result = 0;
+
+	fclose(file);
+
+	return result;
+}
+
+
+// Writes everything emitted to path, by way of a temporary file which
+// replaces it only once it's complete; if path already holds the same
+// text, it's left alone (and its time stamp with it, so the build has
+// nothing new to do).  Either way the output is released.  On failure
+// (see NoDice_Error()) path is left as it was, and the output is kept so
+// the write can be tried again (unless it ran out of memory, in which
+// case there's nothing worth writing and it's released.)
+enum NoDice_emit_result NoDice_emit_commit(struct NoDice_emit *emit, const char *path)
+{
+	char temp_path[PATH_MAX];
+	FILE *file;
+	int result = 1;
+
+	if(emit->failed)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to write %s: out of memory", path);
+		NoDice_emit_free(emit);
+		return EMIT_FAILED;
+	}
+
+	if(NoDice_emit_matches(emit, path))
+	{
+		NoDice_emit_free(emit);
+		return EMIT_UNCHANGED;
+	}
+
+	snprintf(temp_path, PATH_MAX, "%s.tmp", path);
+
+	if( (file = fopen(temp_path, emit->binary ? "wb" : "w")) == NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to write %s: %s", temp_path, strerror(errno));
+		return EMIT_FAILED;
+	}
+
+	if(emit->len > 0 && fwrite(emit->buf, 1, emit->len, file) != (size_t)emit->len)
+		result = 0;
+
+	if(fclose(file) != 0)
+		result = 0;
+
+	if(!result)
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to write %s: %s", temp_path, strerror(errno));
+#ifdef _WIN32
+	// rename() won't replace an existing file here
+	else if(!MoveFileExA(temp_path, path, MOVEFILE_REPLACE_EXISTING))
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to replace %s (error %lu)", path, (unsigned long)GetLastError());
+		result = 0;
+	}
+#else
+	else if(rename(temp_path, path) != 0)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to replace %s: %s", path, strerror(errno));
+		result = 0;
+	}
+#endif
+
+	if(!result)
+	{
+		remove(temp_path);
+		return EMIT_FAILED;
+	}
+
+	NoDice_emit_free(emit);
+
+	return EMIT_WRITTEN;
+}
+
+
+// Throws out the output without writing it
+void NoDice_emit_free(struct NoDice_emit *emit)
+{
+	free(emit->buf);
+
+	emit->buf = NULL;
+	emit->len = emit->alloc = 0;
+}
@@ -1,4 +1,9 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE		// For pipe2
+#endif
+
 #include "NoDiceLib.h"
+#include "internal.h"
 #include <stdlib.h>
 
 #ifdef _WIN32
@@ -11,7 +16,7 @@
 #include <stdio.h>
 #include <strsafe.h>
 
-static void FormError(void (*buffer_callback)(const char *))
+static void FormError(void (*output)(void *, const char *), void *user)
 {
     // Retrieve the system error message for the last-error code
 
@@ -29,12 +34,12 @@ static void FormError(void (*buffer_callback)(const char *))
         0, NULL );
 
 	// Feedback what happened
-	buffer_callback(lpMsgBuf);
+	output(user, lpMsgBuf);
 
     LocalFree(lpMsgBuf);
 }
 
-int NoDice_exec_build(void (*buffer_callback)(const char *))
+int _exec_build(void (*output)(void *user, const char *text), void *user, struct _exec_process *process)
 {
 	int result = 1;
 
@@ -93,10 +98,20 @@ int NoDice_exec_build(void (*buffer_callback)(const char *))
 	// If an error occurs, report it
 	if (!bSuccess)
 	{
-		FormError(buffer_callback);
+		FormError(output, user);
 		return 0;
 	}
 
+	// Now it can be cancelled
+	if(process != NULL)
+	{
+		_mutex_lock(process->lock);
+		process->handle = piProcInfo.hProcess;
+		if(process->cancelled)
+			TerminateProcess(piProcInfo.hProcess, 1);
+		_mutex_unlock(process->lock);
+	}
+
 
 	// Read from pipe that is the standard output for child process
 
@@ -135,8 +150,7 @@ int NoDice_exec_build(void (*buffer_callback)(const char *))
 			}
 
 		// In any case, call callback with buffer
-		if(buffer_callback != NULL)
-			buffer_callback(chBuf);
+		output(user, chBuf);
 	}
 
 	CloseHandle(g_hChildStd_IN_Rd);
@@ -151,6 +165,16 @@ int NoDice_exec_build(void (*buffer_callback)(const char *))
 		result = code == 0;
 	}
 
+	// No longer there to cancel
+	if(process != NULL)
+	{
+		_mutex_lock(process->lock);
+		process->handle = NULL;
+		if(process->cancelled)
+			result = 0;
+		_mutex_unlock(process->lock);
+	}
+
 	// Close handles to the child process and its primary thread.
 	CloseHandle(piProcInfo.hProcess);
 	CloseHandle(piProcInfo.hThread);
@@ -158,100 +182,243 @@ int NoDice_exec_build(void (*buffer_callback)(const char *))
 	return result;
 }
 
+
+// Stops the build running with process (or keeps it from starting)
+void _exec_cancel(struct _exec_process *process)
+{
+	_mutex_lock(process->lock);
+	process->cancelled = 1;
+	if(process->handle != NULL)
+		TerminateProcess((HANDLE)process->handle, 1);
+	_mutex_unlock(process->lock);
+}
+
 #else
 
-// Linux/Unix pipe/dup2 style redirection
+// Linux/Unix: posix_spawn with the output piped back, read with poll
 
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
 #include <unistd.h>
 #include <sys/wait.h>
 
-int NoDice_exec_build(void (*buffer_callback)(const char *))
+extern char **environ;
+
+struct exec_line
 {
-	int result = 1;
-	static char exec_buffer[EXEC_BUF_LINE_LEN];
+	char text[EXEC_BUF_LINE_LEN];
+	int len;
+};
+
+// Hands a finished line (or a piece of one too long to hold) to output
+static void exec_line_flush(struct exec_line *line, int *result, void (*output)(void *user, const char *text), void *user)
+{
+	if(line->len == 0)
+		return;
+
+	line->text[line->len] = '\0';
+	line->len = 0;
+
+	// If we're configured to look for error condition via BUILDERR_TEXTERROR,
+	// we must look to see if the word "error" appears in the line...
+	// This isn't a great test, and I personally prefer by error code, but
+	// nesasm does not return non-zero, so this is what we do...
+	if(
+		// Must be configured to do this check...
+		(NoDice_config.buildinfo.builderr == BUILDERR_TEXTERROR) &&
+
+		// Must not have already decided an ill status...
+		(*result == 1) &&
+
+		// ... and finally, check if "error" is present:
+		stristr(line->text, "error")	)
+		{
+			// Error found, return zero!
+			*result = 0;
+		}
+
+	// In any case, call callback with the line
+	output(user, line->text);
+}
+
+
+static int exec_pipe(int fd[2])
+{
+#ifdef __linux__
+	// Atomic, so a build spawned on another thread can't inherit it
+	return pipe2(fd, O_CLOEXEC);
+#else
+	if(pipe(fd) != 0)
+		return -1;
+
+	fcntl(fd[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fd[1], F_SETFD, FD_CLOEXEC);
+	return 0;
+#endif
+}
+
+
+int _exec_build(void (*output)(void *user, const char *text), void *user, struct _exec_process *process)
+{
+	int result = 1, status = 0, cancelled = 0, err;
+	struct exec_line line;
+	char chunk[4096];
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attr;
+	pid_t pid;
 
 	int fd[2];	// Descriptors for the pipe
 
-	// Create the pipe in/out
-	pipe(fd);
+	line.len = 0;
 
-	// Need to fork for the child process
-	pid_t pid = fork();
-	if(pid == 0)
+	// Create the pipe in/out; neither end is left open in the child
+	// except as its stdout and stderr
+	if(exec_pipe(fd) != 0)
 	{
-		// Child
+		snprintf(line.text, EXEC_BUF_LINE_LEN, "Error creating pipe: %s\n", strerror(errno));
+		output(user, line.text);
+		return 0;
+	}
 
-		// Redirect both stdout and stderr into same pipe
-		dup2(fd[1], STDOUT_FILENO);
-		dup2(fd[1], STDERR_FILENO);
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, fd[1], STDOUT_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, fd[1], STDERR_FILENO);
 
-		// Don't need the input end
-		close(fd[0]);
+	// Own process group, so a cancel reaches anything the build starts
+	posix_spawnattr_init(&attr);
+	posix_spawnattr_setpgroup(&attr, 0);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
 
-		// Run process as configured
-		execvp(NoDice_config.buildinfo.build_argv[0], NoDice_config.buildinfo.build_argv);
+	// Run process as configured
+	err = posix_spawnp(&pid, NoDice_config.buildinfo.build_argv[0], &actions, &attr, NoDice_config.buildinfo.build_argv, environ);
 
-		// You only get here if the process failed to execute...
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&actions);
+	close(fd[1]);
 
+	if(err != 0)
+	{
 		// !!NOTE!! DELIBERATE use of the word "error" in case we're
 		// doing trip-on-word-error!  Make sure that remains...
-		// This will get piped so it will show up on the parent process.
-		perror("Error executing");
+		snprintf(line.text, EXEC_BUF_LINE_LEN, "Error executing: %s\n", strerror(err));
+		output(user, line.text);
+		close(fd[0]);
+		return 0;
+	}
 
-		// And otherwise, we must return non-zero to trip in that case
-		exit(1);
+	// Now it can be cancelled
+	if(process != NULL)
+	{
+		_mutex_lock(process->lock);
+		process->pid = pid;
+		if(process->cancelled)
+			kill(-pid, SIGTERM);
+		_mutex_unlock(process->lock);
 	}
-	else
+
+	fcntl(fd[0], F_SETFL, fcntl(fd[0], F_GETFL) | O_NONBLOCK);
+
+	// Read until every writer is gone, a line at a time
+	for(;;)
 	{
-		// Parent
+		struct pollfd pfd;
+		ssize_t read_amt, i;
+
+		pfd.fd = fd[0];
+		pfd.events = POLLIN;
+
+		if(poll(&pfd, 1, -1) < 0)
+		{
+			if(errno == EINTR)
+				continue;
 
-		int status;
-		size_t read_amt;
+			break;
+		}
+
+		if( (read_amt = read(fd[0], chunk, sizeof(chunk))) < 0)
+		{
+			if(errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+				continue;
+
+			break;
+		}
 
-		dup2(fd[0], STDIN_FILENO);
-		close(fd[1]);
+		// End of output
+		if(read_amt == 0)
+			break;
 
-		while ((read_amt = fread(exec_buffer, 1, EXEC_BUF_LINE_LEN-1, stdin)))
+		for(i = 0; i < read_amt; i++)
 		{
-			// Terminate the string
-			exec_buffer[read_amt] = '\0';
-
-			// If we're configured to look for error condition via BUILDERR_TEXTERROR,
-			// we must look to see if the word "error" appears in the buffer...
-			// This isn't a great test, and I personally prefer by error code, but
-			// nesasm does not return non-zero, so this is what we do...
-			if(
-				// Must be configured to do this check...
-				(NoDice_config.buildinfo.builderr == BUILDERR_TEXTERROR) &&
-
-				// Must not have already decided an ill status...
-				(result == 1) &&
-
-				// ... and finally, check if "error" is present:
-				stristr(exec_buffer, "error")	)
-				{
-					// Error found, return zero!
-					result = 0;
-				}
-
-			// In any case, call callback with buffer
-			if(buffer_callback != NULL)
-				buffer_callback(exec_buffer);
+			line.text[line.len++] = chunk[i];
+
+			if(chunk[i] == '\n' || line.len == EXEC_BUF_LINE_LEN - 1)
+				exec_line_flush(&line, &result, output, user);
 		}
+	}
 
-		// Wait for child to finish
-		waitpid(pid, &status, 0);
+	// Last line, if it had no line break
+	exec_line_flush(&line, &result, output, user);
 
+	close(fd[0]);
 
-		// If configured for return code, check return code for non-zero
-		if(NoDice_config.buildinfo.builderr == BUILDERR_RETURNCODE)
-			result = WEXITSTATUS(status) == 0;
+	// Wait for child to finish, but leave it to be reaped until it's no
+	// longer there to cancel: once reaped its pid could be reused, and
+	// _exec_cancel would signal whatever got it
+	if(process != NULL)
+	{
+		siginfo_t info;
+
+		while(waitid(P_PID, pid, &info, WEXITED | WNOWAIT) < 0 && errno == EINTR)
+			;
 
+		_mutex_lock(process->lock);
+		process->pid = 0;
+		cancelled = process->cancelled;
+		_mutex_unlock(process->lock);
 	}
 
+	while(waitpid(pid, &status, 0) < 0 && errno == EINTR)
+		;
+
+	// If configured for return code, check return code for non-zero
+	if(NoDice_config.buildinfo.builderr == BUILDERR_RETURNCODE)
+		result = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+	if(cancelled)
+		result = 0;
 
 	return result;
 }
 
+
+// Stops the build running with process (or keeps it from starting)
+void _exec_cancel(struct _exec_process *process)
+{
+	_mutex_lock(process->lock);
+	process->cancelled = 1;
+	if(process->pid > 0)
+		kill(-(pid_t)process->pid, SIGTERM);
+	_mutex_unlock(process->lock);
+}
+
 #endif
+
+
+static void exec_callback_output(void *user, const char *text)
+{
+	void (**buffer_callback)(const char *) = (void (**)(const char *))user;
+
+	if(*buffer_callback != NULL)
+		(*buffer_callback)(text);
+}
+
+
+int NoDice_exec_build(void (*buffer_callback)(const char *))
+{
+	return _exec_build(exec_callback_output, &buffer_callback, NULL);
+}
@@ -4,6 +4,13 @@
 #define ERROR_MSG_LEN	8192
 #define BUFFER_LEN		4096
 
+// Thread local storage
+#ifdef _MSC_VER
+#define THREAD_LOCAL	__declspec(thread)
+#else
+#define THREAD_LOCAL	__thread
+#endif
+
 
 // RAM identifiers
 enum SMB3RAM
@@ -43,7 +50,7 @@ extern struct SMB3_RAM
 } _ram[SMB3RAM_TOTAL];
 
 
-extern char _error_msg[ERROR_MSG_LEN];
+extern THREAD_LOCAL char _error_msg[ERROR_MSG_LEN];	// Per-thread so contexts on other threads don't clobber it
 extern char _buffer[BUFFER_LEN];
 
 int _config_init();
@@ -53,5 +60,59 @@ int _rom_load();
 void _rom_free_level_list();
 void _rom_shutdown();
 int _ram_resolve_labels();
+int _rom_PRG_size();
+const char *_rom_label_nearest(unsigned short addr);
+int _rom_PRG_bank_free_space(int bank);
+
+// PRG bank occupancy index (banks.c)
+void _banks_free();
+
+// 6502 profile (profile.c); instructions are counted by "slot", which
+// is the PRG offset of the opcode, or PRG size + address for code that
+// runs from outside PRG
+struct _profile_gen
+{
+	unsigned char tileset, type, id;
+	unsigned long calls, instructions, cycles;
+};
+
+struct NoDice_profile
+{
+	int slot_count;
+	unsigned long *instructions, *cycles;
+	unsigned short bank_window[256];	// Address each PRG bank was last run at
+
+	struct _profile_gen *gens;	// Generators run, in order first seen
+	int gen_count, gen_alloc;
+};
+int _profile_gen_index(struct NoDice_profile *profile, unsigned char tileset, unsigned char type, unsigned char id);
+
+// Planar NES CHR to one byte per pixel (chr.c)
+void _chr_decode(const unsigned char *planar, unsigned char *linear, int tiles);
+int _chr_test(const unsigned char *CHR, int CHR_tiles, struct NoDice_chr_test *test);
+
+// Minimal portable threads (thread.c)
+typedef struct _thread *_thread_t;
+typedef struct _mutex *_mutex_t;
+_thread_t _thread_create(void (*func)(void *), void *arg);
+void _thread_join(_thread_t thread);
+int _thread_cpu_count();
+_mutex_t _mutex_create();
+void _mutex_lock(_mutex_t mutex);
+void _mutex_unlock(_mutex_t mutex);
+void _mutex_destroy(_mutex_t mutex);
+
+// Build runner (exec.c); output is handed over as it is read.  If
+// process is given (its lock created and the rest zeroed), another
+// thread can stop the build with _exec_cancel().
+struct _exec_process
+{
+	_mutex_t lock;
+	int cancelled;
+	long pid;		// Running process (POSIX), 0 if none
+	void *handle;	// Running process (Windows), NULL if none
+};
+int _exec_build(void (*output)(void *user, const char *text), void *user, struct _exec_process *process);
+void _exec_cancel(struct _exec_process *process);
 
 #endif // _INTERNAL_H
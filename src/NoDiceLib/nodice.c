@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <sys/stat.h>
 
 #ifndef WIN32
@@ -13,44 +14,31 @@
 #include "internal.h"
 #include "M6502/M6502.h"
 
-char _error_msg[ERROR_MSG_LEN];
+THREAD_LOCAL char _error_msg[ERROR_MSG_LEN];
 char _buffer[BUFFER_LEN];
 
-static int exec_buffer_pos = 0;
-static void exec_buffer_callback(const char *next_line)
+// Runs the build and waits for it; returns NULL on success, otherwise
+// an error message with (the beginning of) the assembler's output
+const char *NoDice_DoBuild()
 {
-	// The buffer space is limited, and hopefully the user never has to see it,
-	// but we need to be able to give them a hint if the assembly fails...
-
-	// Make sure we haven't hit the end of the buffer
-	if(exec_buffer_pos < (ERROR_MSG_LEN-1) )
-	{
-		// Number of characters for next line of output
-		int len = strlen(next_line), max = (ERROR_MSG_LEN-1) - exec_buffer_pos;
+	struct NoDice_build *build;
 
-		if(max > 0)
-		{
-			// Use strncat to limit number of characters we copy up to
-			// what's remaining in the buffer
-			strncat(_error_msg, next_line, max);
+	if( (build = NoDice_build_start()) == NULL)
+		return _error_msg;
 
-			// Advance position
-			exec_buffer_pos += len;
-		}
+	if(NoDice_build_wait(build) == BUILD_SUCCEEDED)
+	{
+		NoDice_build_destroy(build);
+		return NULL;
 	}
-}
 
-const char *NoDice_DoBuild()
-{
-	// Start with beginning of message, assuming failure
-	// If there's no failure the user never sees this!
-	strcpy(_error_msg, "ROM ASSEMBLY FAILED; beginning of output:\n");
-	exec_buffer_pos = strlen(_error_msg);
+	// Start with beginning of message; hopefully the user never has to
+	// see it, but it's a hint if the assembly fails...
+	snprintf(_error_msg, ERROR_MSG_LEN, "ROM ASSEMBLY FAILED; beginning of output:\n%s", NoDice_build_log(build));
 
-	if(!NoDice_exec_build(exec_buffer_callback))
-		return _error_msg;
-	else
-		return NULL;
+	NoDice_build_destroy(build);
+
+	return _error_msg;
 }
 
 
@@ -102,13 +90,196 @@ static int verify_generated_files()
 }
 
 
+#define DEPS_DEPTH_MAX	32	// Deepest .include nesting followed
+
+enum DEPS_DIRECTIVE
+{
+	DEPS_NONE,
+	DEPS_INCLUDE,	// Assembly; its own includes count too
+	DEPS_INCBIN		// Binary
+};
+
+// Every file the build reads, as found so far
+struct deps_scan
+{
+	char **files;
+	int count, alloc;
+	time_t newest;
+};
+
+
+// Finds an .include or .incbin on the line (after a label, if any);
+// the file name is cut out of line in place
+static enum DEPS_DIRECTIVE deps_directive(char *line, char **file)
+{
+	char *p = line;
+	int token;
+
+	for(token = 0; token < 2; token++)
+	{
+		enum DEPS_DIRECTIVE directive = DEPS_NONE;
+		char *start, saved;
+
+		while(isspace((unsigned char)*p))
+			p++;
+
+		if(*p == ';' || *p == '\0')
+			return DEPS_NONE;
+
+		start = (*p == '.') ? p + 1 : p;
+		while(*p != '\0' && *p != ';' && !isspace((unsigned char)*p))
+			p++;
+
+		saved = *p;
+		*p = '\0';
+
+		if(!strcasecmp(start, "include"))
+			directive = DEPS_INCLUDE;
+		else if(!strcasecmp(start, "incbin"))
+			directive = DEPS_INCBIN;
+
+		*p = saved;
+
+		if(directive == DEPS_NONE)
+			continue;
+
+		while(isspace((unsigned char)*p))
+			p++;
+
+		if(*p == '"')
+		{
+			*file = ++p;
+			if( (p = strchr(p, '"')) == NULL)
+				return DEPS_NONE;
+		}
+		else
+		{
+			*file = p;
+			while(*p != '\0' && *p != ';' && !isspace((unsigned char)*p))
+				p++;
+		}
+
+		*p = '\0';
+
+		return (**file != '\0') ? directive : DEPS_NONE;
+	}
+
+	return DEPS_NONE;
+}
+
+
+// Adds file (and for assembly, whatever it includes) to the scan;
+// returns 0 if any of it couldn't be read
+static int deps_scan_file(struct deps_scan *scan, const char *file, enum DEPS_DIRECTIVE directive, int depth)
+{
+	struct stat stat_buf;
+	char line[512], *included;
+	FILE *asm_file;
+	int i, result = 1;
+
+	// Already counted
+	for(i = 0; i < scan->count; i++)
+	{
+		if(!strcmp(scan->files[i], file))
+			return 1;
+	}
+
+	if(depth > DEPS_DEPTH_MAX || stat(file, &stat_buf) == -1)
+		return 0;
+
+	if(scan->count == scan->alloc)
+	{
+		int alloc = (scan->alloc > 0) ? scan->alloc * 2 : 64;
+		char **files = (char **)realloc(scan->files, alloc * sizeof(char *));
+
+		if(files == NULL)
+			return 0;
+
+		scan->files = files;
+		scan->alloc = alloc;
+	}
+
+	if( (scan->files[scan->count] = strdup(file)) == NULL)
+		return 0;
+
+	scan->count++;
+
+	if(stat_buf.st_mtime > scan->newest)
+		scan->newest = stat_buf.st_mtime;
+
+	if(directive != DEPS_INCLUDE)
+		return 1;
+
+	if( (asm_file = fopen(file, "r")) == NULL)
+		return 0;
+
+	while(result && fgets(line, sizeof(line), asm_file) != NULL)
+	{
+		enum DEPS_DIRECTIVE found = deps_directive(line, &included);
+
+		if(found != DEPS_NONE)
+			result = deps_scan_file(scan, included, found, depth + 1);
+	}
+
+	fclose(asm_file);
+
+	return result;
+}
+
+
+// Returns 1 if the ROM and FNS are newer than the root assembly file
+// and everything it includes, i.e. a build wouldn't change anything
+static int deps_up_to_date()
+{
+	struct deps_scan scan;
+	struct stat stat_buf;
+	time_t oldest_output;
+	int i, result;
+
+	snprintf(_buffer, BUFFER_LEN, "%s" EXT_ROM, NoDice_config.filebase);
+	if(stat(_buffer, &stat_buf) == -1)
+		return 0;
+	oldest_output = stat_buf.st_mtime;
+
+	snprintf(_buffer, BUFFER_LEN, "%s" EXT_SYMBOLS, NoDice_config.filebase);
+	if(stat(_buffer, &stat_buf) == -1)
+		return 0;
+	if(stat_buf.st_mtime < oldest_output)
+		oldest_output = stat_buf.st_mtime;
+
+	memset(&scan, 0, sizeof(scan));
+
+	snprintf(_buffer, BUFFER_LEN, "%s" EXT_ASM, NoDice_config.filebase);
+	result = deps_scan_file(&scan, _buffer, DEPS_INCLUDE, 0);
+
+	// Strictly newer; an edit in the same second as the last build
+	// could otherwise go unassembled
+	result = result && (oldest_output > scan.newest);
+
+	for(i = 0; i < scan.count; i++)
+		free(scan.files[i]);
+	free(scan.files);
+
+	return result;
+}
+
+
+// Returns 1 if the sources have changed since the ROM and FNS were
+// last built (or they can't be checked)
+int NoDice_build_needed()
+{
+	return !deps_up_to_date();
+}
+
+
 int NoDice_Init()
 {
 	if(!_config_init())
 		return 0;
 
-	// Attempt to run a build to test the configuration before we proceed
-	if(NoDice_DoBuild() != NULL)
+	// Attempt to run a build to test the configuration before we proceed,
+	// unless the last one is still good
+	if((NoDice_config.buildinfo.force || NoDice_build_needed()) && NoDice_DoBuild() != NULL)
 		return 0;
 
 	// If build succeeded, make sure we have new FNS and NES files
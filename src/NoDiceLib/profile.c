@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "NoDiceLib.h"
+#include "internal.h"
+
+#define PROFILE_NAME_LEN	64
+
+// One line of a report
+struct profile_entry
+{
+	char name[PROFILE_NAME_LEN];
+	int bank;		// PRG bank (-1 if not in PRG or not applicable)
+	int tileset;	// Tileset (-1 if not applicable)
+	unsigned long calls, instructions, cycles;
+};
+
+
+// Creates an empty profile; attach it to a context with
+// NoDice_context_set_profile() to start counting.  Returns NULL on failure,
+// which is always the case unless built with PROFILE6502.
+struct NoDice_profile *NoDice_profile_create()
+{
+	struct NoDice_profile *profile;
+
+#ifndef PROFILE6502
+	// The 6502 core wouldn't count anything into it
+	snprintf(_error_msg, ERROR_MSG_LEN, "Profiling needs NoDiceLib built with PROFILE6502 (make PROFILE=1)");
+	return NULL;
+#endif
+
+	profile = (struct NoDice_profile *)calloc(1, sizeof(struct NoDice_profile));
+
+	if(profile == NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to allocate profile");
+		return NULL;
+	}
+
+	profile->slot_count = _rom_PRG_size() + 0x8000;
+	profile->instructions = (unsigned long *)calloc(profile->slot_count, sizeof(unsigned long));
+	profile->cycles = (unsigned long *)calloc(profile->slot_count, sizeof(unsigned long));
+
+	if(profile->instructions == NULL || profile->cycles == NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to allocate profile");
+		NoDice_profile_destroy(profile);
+		return NULL;
+	}
+
+	return profile;
+}
+
+
+void NoDice_profile_destroy(struct NoDice_profile *profile)
+{
+	if(profile == NULL)
+		return;
+
+	free(profile->instructions);
+	free(profile->cycles);
+	free(profile->gens);
+	free(profile);
+}
+
+
+// Returns the index of the generator's entry in the profile, adding
+// it if needed, or -1 if out of memory
+int _profile_gen_index(struct NoDice_profile *profile, unsigned char tileset, unsigned char type, unsigned char id)
+{
+	struct _profile_gen *gen;
+	int i;
+
+	for(i = 0; i < profile->gen_count; i++)
+	{
+		gen = &profile->gens[i];
+
+		if(gen->tileset == tileset && gen->type == type && gen->id == id)
+			return i;
+	}
+
+	if(profile->gen_count == profile->gen_alloc)
+	{
+		int alloc = (profile->gen_alloc > 0) ? profile->gen_alloc * 2 : 64;
+
+		if( (gen = (struct _profile_gen *)realloc(profile->gens, alloc * sizeof(struct _profile_gen))) == NULL)
+			return -1;
+
+		profile->gens = gen;
+		profile->gen_alloc = alloc;
+	}
+
+	gen = &profile->gens[profile->gen_count];
+	memset(gen, 0, sizeof(struct _profile_gen));
+	gen->tileset = tileset;
+	gen->type = type;
+	gen->id = id;
+
+	return profile->gen_count++;
+}
+
+
+// Adds the counts from src into dest (e.g. to total up profiles from
+// contexts on several threads)
+void NoDice_profile_merge(struct NoDice_profile *dest, const struct NoDice_profile *src)
+{
+	int i;
+
+	for(i = 0; i < dest->slot_count && i < src->slot_count; i++)
+	{
+		dest->instructions[i] += src->instructions[i];
+		dest->cycles[i] += src->cycles[i];
+	}
+
+	for(i = 0; i < 256; i++)
+		if(src->bank_window[i] != 0)
+			dest->bank_window[i] = src->bank_window[i];
+
+	for(i = 0; i < src->gen_count; i++)
+	{
+		const struct _profile_gen *gen = &src->gens[i];
+		int index = _profile_gen_index(dest, gen->tileset, gen->type, gen->id);
+
+		if(index >= 0)
+		{
+			dest->gens[index].calls += gen->calls;
+			dest->gens[index].instructions += gen->instructions;
+			dest->gens[index].cycles += gen->cycles;
+		}
+	}
+}
+
+
+static const char *profile_gen_name(unsigned char tileset, unsigned char type, unsigned char id)
+{
+	static THREAD_LOCAL char name[PROFILE_NAME_LEN];
+	int i, j;
+
+	for(i = 0; i < NoDice_config.game.tileset_count; i++)
+	{
+		const struct NoDice_tileset *ts = &NoDice_config.game.tilesets[i];
+
+		if(ts->id != tileset)
+			continue;
+
+		for(j = 0; j < ts->gen_count; j++)
+		{
+			if(ts->generators[j].type == type && ts->generators[j].id == id && ts->generators[j].name != NULL)
+				return ts->generators[j].name;
+		}
+	}
+
+	snprintf(name, sizeof(name), "%s $%02X",
+		(type == GENTYPE_JCTSTART) ? "Junction" : (type == GENTYPE_VARIABLE) ? "Variable" : "Fixed", id);
+
+	return name;
+}
+
+
+static int profile_entry_compare(const void *a, const void *b)
+{
+	const struct profile_entry *ea = (const struct profile_entry *)a, *eb = (const struct profile_entry *)b;
+
+	if(ea->cycles != eb->cycles)
+		return (ea->cycles < eb->cycles) ? 1 : -1;
+
+	return strcmp(ea->name, eb->name);
+}
+
+
+// Totals up the slots by the nearest label preceding them (per bank)
+static struct profile_entry *profile_by_label(const struct NoDice_profile *profile, int *count)
+{
+	struct profile_entry *entries = NULL, *last = NULL;
+	int PRG_size = profile->slot_count - 0x8000;
+	int i, j, alloc = 0;
+
+	*count = 0;
+
+	for(i = 0; i < profile->slot_count; i++)
+	{
+		const char *label;
+		unsigned short addr;
+		int bank;
+
+		if(profile->instructions[i] == 0)
+			continue;
+
+		if(i < PRG_size)
+		{
+			bank = i / 8192;
+			addr = profile->bank_window[bank] + (i % 8192);
+		}
+		else
+		{
+			bank = -1;
+			addr = (unsigned short)(i - PRG_size);
+		}
+
+		// Consecutive slots are nearly always the same routine
+		if( (label = _rom_label_nearest(addr)) == NULL)
+			label = "(no label)";
+
+		if(last == NULL || last->bank != bank || strcmp(last->name, label))
+		{
+			for(j = 0, last = NULL; j < *count; j++)
+			{
+				if(entries[j].bank == bank && !strcmp(entries[j].name, label))
+				{
+					last = &entries[j];
+					break;
+				}
+			}
+		}
+
+		if(last == NULL)
+		{
+			if(*count == alloc)
+			{
+				struct profile_entry *grown;
+
+				alloc = (alloc > 0) ? alloc * 2 : 256;
+				if( (grown = (struct profile_entry *)realloc(entries, alloc * sizeof(struct profile_entry))) == NULL)
+				{
+					free(entries);
+					*count = 0;
+					return NULL;
+				}
+
+				entries = grown;
+			}
+
+			last = &entries[(*count)++];
+			memset(last, 0, sizeof(struct profile_entry));
+			strncpy(last->name, label, PROFILE_NAME_LEN - 1);
+			last->bank = bank;
+			last->tileset = -1;
+		}
+
+		last->instructions += profile->instructions[i];
+		last->cycles += profile->cycles[i];
+	}
+
+	return entries;
+}
+
+
+static void profile_write(FILE *out, int csv, const char *kind, const struct profile_entry *entries, int count, unsigned long total_cycles)
+{
+	int i;
+
+	for(i = 0; i < count; i++)
+	{
+		const struct profile_entry *e = &entries[i];
+		double percent = (total_cycles > 0) ? (e->cycles * 100.0 / total_cycles) : 0.0;
+
+		if(csv)
+		{
+			// Quote the name; labels won't have quotes, generator names might
+			const char *c;
+
+			fprintf(out, "%s,", kind);
+			if(e->tileset >= 0)
+				fprintf(out, "%i", e->tileset);
+			fprintf(out, ",");
+			if(e->bank >= 0)
+				fprintf(out, "%i", e->bank);
+			fprintf(out, ",\"");
+			for(c = e->name; *c != '\0'; c++)
+			{
+				if(*c == '"')
+					fputc('"', out);
+				fputc(*c, out);
+			}
+			fprintf(out, "\",%lu,%lu,%lu,%.2f\n", e->calls, e->instructions, e->cycles, percent);
+		}
+		else if(e->tileset >= 0)
+			fprintf(out, "%12lu %6.2f%% %12lu %8lu %7i  %s\n", e->cycles, percent, e->instructions, e->calls, e->tileset, e->name);
+		else if(e->bank >= 0)
+			fprintf(out, "%12lu %6.2f%% %12lu %4i  %s\n", e->cycles, percent, e->instructions, e->bank, e->name);
+		else
+			fprintf(out, "%12lu %6.2f%% %12lu    -  %s\n", e->cycles, percent, e->instructions, e->name);
+	}
+}
+
+
+// Writes a report of where the profiled 6502 time went to out, sorted
+// by cycles: by the nearest preceding FNS label (per PRG bank) and by
+// generator.  FNS labels carry no bank, so code in a switched bank is
+// credited to the nearest label by address alone.  Cycles are base
+// cycles (no branch penalties.)  If csv is set, it's written as one
+// CSV table instead.  Returns 0 on failure.
+int NoDice_profile_report(const struct NoDice_profile *profile, FILE *out, int csv)
+{
+	struct profile_entry *labels, *gens;
+	unsigned long total_instructions = 0, total_cycles = 0;
+	int i, label_count, gen_count = profile->gen_count;
+
+	for(i = 0; i < profile->slot_count; i++)
+	{
+		total_instructions += profile->instructions[i];
+		total_cycles += profile->cycles[i];
+	}
+
+	if( (labels = profile_by_label(profile, &label_count)) == NULL && label_count > 0)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to allocate profile report");
+		return 0;
+	}
+
+	if( (gens = (struct profile_entry *)calloc(gen_count > 0 ? gen_count : 1, sizeof(struct profile_entry))) == NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to allocate profile report");
+		free(labels);
+		return 0;
+	}
+
+	for(i = 0; i < gen_count; i++)
+	{
+		const struct _profile_gen *gen = &profile->gens[i];
+
+		snprintf(gens[i].name, PROFILE_NAME_LEN, "%s", profile_gen_name(gen->tileset, gen->type, gen->id));
+		gens[i].bank = -1;
+		gens[i].tileset = gen->tileset;
+		gens[i].calls = gen->calls;
+		gens[i].instructions = gen->instructions;
+		gens[i].cycles = gen->cycles;
+	}
+
+	if(label_count > 0)
+		qsort(labels, label_count, sizeof(struct profile_entry), profile_entry_compare);
+	if(gen_count > 0)
+		qsort(gens, gen_count, sizeof(struct profile_entry), profile_entry_compare);
+
+	if(csv)
+	{
+		fprintf(out, "kind,tileset,bank,name,calls,instructions,cycles,cycles_percent\n");
+		profile_write(out, 1, "label", labels, label_count, total_cycles);
+		profile_write(out, 1, "generator", gens, gen_count, total_cycles);
+	}
+	else
+	{
+		fprintf(out, "6502 profile: %lu instructions, %lu cycles\n\n", total_instructions, total_cycles);
+
+		fprintf(out, "By label:\n");
+		fprintf(out, "%12s %7s %12s %4s  %s\n", "Cycles", "%", "Instructions", "Bank", "Label");
+		profile_write(out, 0, NULL, labels, label_count, total_cycles);
+
+		fprintf(out, "\nBy generator (while running; the replay cache is off while profiling):\n");
+		fprintf(out, "%12s %7s %12s %8s %7s  %s\n", "Cycles", "%", "Instructions", "Calls", "Tileset", "Generator");
+		profile_write(out, 0, NULL, gens, gen_count, total_cycles);
+	}
+
+	free(labels);
+	free(gens);
+
+	return 1;
+}
@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <sys/stat.h>
 #include "NoDiceLib.h"
 #include "internal.h"
 #include "M6502/M6502.h"
@@ -37,6 +39,31 @@
 
 #define MMC3_BANKSIZE	8192
 
+// The 6502 address space is divided into 2KB pages, each of which either
+// points directly at the memory backing it (RAM, the current PRG banks,
+// etc.) or is "hooked" so the access goes through the slower full decode
+// (MMC3 registers, interrupt vectors, level loading capture, ...)
+#define MEMMAP_PAGE_SHIFT	11
+#define MEMMAP_PAGE_SIZE	(1 << MEMMAP_PAGE_SHIFT)
+#define MEMMAP_PAGE_MASK	(MEMMAP_PAGE_SIZE - 1)
+#define MEMMAP_PAGES		(0x10000 >> MEMMAP_PAGE_SHIFT)
+
+#define MEMMAP_HOOK_READ	0x01	// Reads of this page go through rom_Rd6502_hooked
+#define MEMMAP_HOOK_WRITE	0x02	// Writes to this page go through rom_Wr6502_hooked
+
+#define TRAPS_MAX			32		// Maximum number of registered traps
+
+#define CHECKPOINT_INTERVAL	16		// Generators between checkpoints; see rom_checkpoint_save()
+
+#define GEN_BLOCK_SIZE		256		// Generators per block of a context's generator arena
+
+#define CORE_BUDGET_PERIOD	4096	// Cycles between calls to Loop6502 (which checks the budget)
+
+#define REPLAY_BUCKETS		1024	// Hash buckets in generator replay cache (power of 2)
+#define REPLAY_MAX_ENTRIES	4096	// Cache is flushed when it grows past this many entries
+#define REPLAY_MAX_INPUTS	256		// Most memory reads a generator may depend on and be cached
+#define REPLAY_MAX_WRITES	8192	// Most memory writes a generator may make and be cached
+
 
 // A few RAM variables that we need
 #define Temp_Var15				Rd6502(_ram[TEMP_VAR15].address)	// General temporary, but used for capturing generators
@@ -74,46 +101,360 @@
 
 typedef const unsigned char *rom_t;
 
-static M6502 CPU_Context;
-volatile enum RUN6502_STOP_REASON NoDice_Run6502_Stop = RUN6502_STOP_NOTSTOPPED;
 static int PRG_size;
 static unsigned short CHR_banks;
 
-// Trap functions needed to extract level data
-static unsigned short LoadLevel_StoreJctStart, LeveLoad_Generators, LeveLoad_FixedSizeGens;
-
-// Holds the PRG and (decoded) CHR images
+// Holds the PRG and (still planar) CHR images; shared by all contexts
 static rom_t _PRG = NULL, _CHR = NULL;
 
-// Emulates MMC3 banking
-static rom_t _PRG_A, _PRG_B, _PRG_C, _PRG_D;
+// What is known about each 8KB PRG bank; NoDice_PRG_refresh compares
+// the banks so only what was built from the changed ones is thrown out
+#define PRG_BANKS_MAX	(255 * 2)	// iNES counts PRG in 16KB pages
+
+static struct rom_PRG_bank
+{
+	unsigned int hash;		// FNV-1a of the bank's contents
+	unsigned int serial;	// rom_PRG_serial as of the bank's last change
+	unsigned char changed;	// Changed by the last NoDice_PRG_refresh
+	int free_space;			// For NoDice_get_tilebank_free_space (-1 if not yet known)
+} _PRG_banks[PRG_BANKS_MAX];
+
+// CHR is only decoded to 8bpp when asked for; each entry of the cache
+// holds the bank asked for and the one after it (see NoDice_get_raw_CHR_bank)
+#define CHR_CACHE_ENTRIES	8
+#define CHR_BANK_DECODED	(64 * 64)	// Bytes of one 1KB CHR bank decoded (64 tiles of 64 pixels)
+
+static struct rom_CHR_cache
+{
+	int bank;				// First bank held (-1 if empty)
+	unsigned long last_used;
+	unsigned char data[CHR_BANK_DECODED * 2];
+} _CHR_cache[CHR_CACHE_ENTRIES];
+static unsigned long _CHR_cache_clock = 0;
+
+#ifdef DECODE6502
+// The instruction starting at each byte of PRG, predecoded for the
+// core (Len 0 if Decode6502 won't hand it out); see rom_decode_PRG()
+static Dec6502 *_PRG_decoded = NULL;
+
+// Length of each 6502 instruction by opcode; 0 for undefined opcodes
+static const unsigned char rom_opcode_length[256] =
+{
+	1,2,0,0,0,2,2,0,1,2,1,0,0,3,3,0,
+	2,2,0,0,0,2,2,0,1,3,0,0,0,3,3,0,
+	3,2,0,0,2,2,2,0,1,2,1,0,3,3,3,0,
+	2,2,0,0,0,2,2,0,1,3,0,0,0,3,3,0,
+	1,2,0,0,0,2,2,0,1,2,1,0,3,3,3,0,
+	2,2,0,0,0,2,2,0,1,3,0,0,0,3,3,0,
+	1,2,0,0,0,2,2,0,1,2,1,0,3,3,3,0,
+	2,2,0,0,0,2,2,0,1,3,0,0,0,3,3,0,
+	0,2,0,0,2,2,2,0,1,0,1,0,3,3,3,0,
+	2,2,0,0,2,2,2,0,1,3,1,0,0,3,0,0,
+	2,2,2,0,2,2,2,0,1,2,1,0,3,3,3,0,
+	2,2,0,0,2,2,2,0,1,3,1,0,3,3,3,0,
+	2,2,0,0,2,2,2,0,1,2,1,0,3,3,3,0,
+	2,2,0,0,0,2,2,0,1,3,0,0,0,3,3,0,
+	2,2,0,0,2,2,2,0,1,2,1,0,3,3,3,0,
+	2,2,0,0,0,2,2,0,1,3,0,0,0,3,3,0
+};
+#endif
+
+// A registered trap; see NoDice_context_trap_add
+struct rom_trap
+{
+	unsigned short addr;
+	NoDice_trap_callback callback;
+	void *user;
+};
+
+// Page table memory map entry; see rom_memmap_update()
+struct rom_memmap_page
+{
+	const unsigned char *read;	// Start of memory backing this page for reads (if not hooked)
+	unsigned char *write;		// Start of memory backing this page for writes (if not hooked)
+	unsigned char hook;			// MEMMAP_HOOK_* flags
+};
+
+// Emulator state captured as a generator begins during a raw level
+// reload, so a later reload of the same data with changes only past
+// this point can resume here; see rom_checkpoint_save()
+struct rom_checkpoint
+{
+	M6502 CPU;			// PC is the address of the generator trap
+	rom_t _PRG_A, _PRG_B, _PRG_C, _PRG_D;
+	unsigned char MMC3_Command;
+	unsigned char _RAM[ (MEM_B_END - MEM_B_START + 1) + (MEM_A_END - MEM_A_START + 1) ];
+
+	unsigned short tile_id_grid[TILEMEM_END - TILEMEM_BASE];
+	unsigned char Level_JctXLHStart[LEVEL_JCT_STARTS], Level_JctYLHStart[LEVEL_JCT_STARTS];
+
+	struct NoDice_the_level_generator prev_gen;	// Generator before this one, not yet patched
+	unsigned short prev_gen_start_addr;
+
+	int gen_count;		// Generators already loaded
+	int data_offset;	// Bytes of level data read so far
+	unsigned long cycles_run;
+};
 
-// Scratch space for modified levels; see defs for SCRATCH_START/END
-static unsigned char _PRG_FakeScratch[SCRATCH_END - SCRATCH_START + 1];
+// What identifies a generator invocation in the replay cache
+struct rom_replay_key
+{
+	unsigned char tileset, type, id, p0;
+	unsigned char bank_A, bank_B, bank_C, bank_D;	// PRG banks mapped in
+	unsigned short addr_start;
+};
 
-// NES RAM and MMC3 RAM
-static unsigned char _RAM[ (MEM_B_END - MEM_B_START + 1) + (MEM_A_END - MEM_A_START + 1) ] = { 0 };
+// A memory read (input) or write (output) of a recorded generator
+struct rom_replay_access
+{
+	unsigned short addr;
+	unsigned char value;
+};
+
+// The recorded effect of running a generator; if every input (and the
+// CPU registers going in) match, running the generator again would just
+// make the same writes and return with the same registers
+struct rom_replay_entry
+{
+	struct rom_replay_entry *next;	// Next in hash bucket
+	struct rom_replay_key key;
+	byte impure;		// Generator can't be replayed (reads tile memory it didn't write, etc.)
 
-// Current MMC3 command
-static unsigned char MMC3_Command = 0x00;
+	byte in_A, in_X, in_Y, in_P, in_S;	// Registers going in
+	byte out_A, out_X, out_Y, out_P, out_S;	// Registers coming out
+	unsigned short out_PC;			// Where it returned to
 
+	int input_count, write_count;
+	struct rom_replay_access *inputs, *writes;	// Allocated along with the entry
+};
 
-// ROM label resolver
+// Everything the 6502 needs to run and load a level; the PRG, CHR and
+// symbols are not part of this and are shared (read-only) by all of them
+struct NoDice_context
+{
+	M6502 CPU_Context;
+
+	// Emulates MMC3 banking
+	rom_t _PRG_A, _PRG_B, _PRG_C, _PRG_D;
+
+	// Current MMC3 command
+	unsigned char MMC3_Command;
+
+	// Scratch space for modified levels; see defs for SCRATCH_START/END
+	unsigned char _PRG_FakeScratch[SCRATCH_END - SCRATCH_START + 1];
+
+	// NES RAM and MMC3 RAM
+	unsigned char _RAM[ (MEM_B_END - MEM_B_START + 1) + (MEM_A_END - MEM_A_START + 1) ];
+
+	// Page table memory map; see rom_memmap_update()
+	struct rom_memmap_page memmap[MEMMAP_PAGES];
+
+	// Registered traps; a set bit in trap_bitmap means at least one trap
+	// in traps[] is on that address (checked only on hooked pages)
+	unsigned char trap_bitmap[0x10000 / 8];
+	struct rom_trap traps[TRAPS_MAX];
+	int trap_count;
+
+	// Trap functions needed to extract level data
+	unsigned short LoadLevel_StoreJctStart, LeveLoad_Generators, LeveLoad_FixedSizeGens;
+	unsigned short gen_traps[3];	// As registered; see rom_set_loading_level
+
+	// Required stuff for level loading
+	byte is_loading_level;	// Set to enable any of the following
+	struct NoDice_the_level_generator *cur_gen, *prev_gen;
+	unsigned short prev_gen_start_addr;	// Start address of generator; for determining size
+
+	// The level loaded by this context and the reason the 6502 stopped;
+	// for the default context these are NoDice_the_level and
+	// NoDice_Run6502_Stop, otherwise the storage below
+	struct NoDice_level *level;
+	volatile enum RUN6502_STOP_REASON *stop;
+
+	struct NoDice_level own_level;
+	volatile enum RUN6502_STOP_REASON own_stop;
+
+	unsigned long cycles_run;	// Cycles run since reset, counted against NoDice_config.core6502_budget
+
+	// The level's generators are carved out of these blocks in order,
+	// which are kept and reused from one level load to the next; see
+	// rom_gen_alloc()
+	struct NoDice_the_level_generator **gen_blocks;
+	int gen_block_count;
+	int gen_used;		// Slots handed out since the level's generators were freed
+
+	// Checkpoints taken by the last raw reload and the level data it
+	// ran with, for NoDice_context_load_level_raw_data to resume from
+	struct rom_checkpoint *checkpoints;
+	int checkpoint_count, checkpoint_alloc;
+	byte checkpointing;		// Set while taking checkpoints
+	unsigned char checkpoint_data[SCRATCH_END - SCRATCH_START + 1];
+	int checkpoint_data_size;	// 0 if the checkpoints are not usable
+	unsigned char checkpoint_tileset;
+	unsigned int checkpoint_PRG_serial;
+	unsigned char checkpoint_banks[PRG_BANKS_MAX / 8 + 1];	// PRG banks mapped in during the reload
+
+#ifdef DECODE6502
+	// Entries in _PRG_decoded for the PRG banks mapped at each of
+	// 8000, A000, C000 and E000
+	const Dec6502 *decode_bank[4];
+#endif
+
+	// Profile being counted into, if any; profile_gen is the entry of
+	// the generator running (-1 if none), until S rises past profile_gen_S
+	struct NoDice_profile *profile;
+	int profile_gen;
+	byte profile_gen_S;
+
+	// Generator replay cache; see rom_replay_begin()
+	struct rom_replay_entry *replay_buckets[REPLAY_BUCKETS];
+	int replay_entry_count;
+	unsigned int replay_PRG_serial;
+	struct NoDice_replay_stats replay_stats;
+	byte replay_nop;		// Generator was replayed, so its trapped opcode fetch gets a NOP
+
+	// Generator currently being recorded (if replay_recording); all of
+	// RAM is hooked until it returns (see rom_memmap_update)
+	byte replay_recording;
+	struct rom_replay_entry replay_rec;	// Key and registers (inputs/writes below)
+	unsigned short replay_return_addr;
+	byte replay_return_S;
+	unsigned char replay_written[MEM_B_END / 8 + 1];	// Addresses the generator wrote
+	unsigned char replay_seen[MEM_B_END / 8 + 1];		// Addresses already recorded as inputs
+	struct rom_replay_access replay_inputs[REPLAY_MAX_INPUTS];
+	struct rom_replay_access replay_writes[REPLAY_MAX_WRITES];
+	int replay_input_count, replay_write_count;
+};
+
+
+// ROM label resolver; the labels in FNS order, hashed by name, plus an
+// index of them sorted by address for going the other way
 static struct ROM_label
 {
 	char label[32];
 	unsigned short address;
-	struct ROM_label *next;
+	int hash_next;		// Next label in the same hash bucket (-1 for none)
 } *ROM_labels = NULL;
+static int ROM_label_count = 0, ROM_label_alloc = 0;
+static int *ROM_label_hash = NULL;		// First label in each bucket (-1 for none)
+static int ROM_label_hash_size = 0;		// Buckets (power of 2)
+static int *ROM_labels_by_addr = NULL;	// Label indexes by address (FNS order among equal addresses)
+
+// The binary symbol cache (EXT_SYMBOL_CACHE) is this header followed by
+// ROM_labels, ROM_label_hash and ROM_labels_by_addr exactly as they are
+// in memory; it's only used if it was built from an FNS of the same
+// size and contents (by hash; a rebuild which only moves addresses keeps
+// the size, and may well land in the same second), by a build with the
+// same ROM_label layout
+#define SYMBOL_CACHE_MAGIC	"NDSC"
+
+struct rom_symbol_cache_header
+{
+	char magic[4];
+	unsigned int header_size, label_size;
+	unsigned int fns_size, fns_hash;
+	int label_count, hash_size;
+};
+
+static struct NoDice_symbol_stats rom_symbol_stats;
+
+// Labels with handles; each has its address looked up again whenever the
+// symbols are loaded (see NoDice_get_label_handle)
+static struct ROM_label_handle
+{
+	char label[32];
+	unsigned short address;
+} *ROM_label_handles = NULL;
+static int ROM_label_handle_count = 0;
+
+// Labels needed by every level load, by handle
+enum ROM_HOT_LABELS
+{
+	HOT_PAGE_A000_BYTILESET,
+	HOT_PAGE_C000_BYTILESET,
+	HOT_LEVEL_BG_PAGES1,
+	HOT_LEVEL_BG_PAGES2,
+	HOT_TILELAYOUT_BYTILESET,
+	HOT_PALETTE_BY_TILESET,
+	HOT_LEVELLOAD_BYTILESET,
+	HOT_LOADLEVEL_STOREJCTSTART,
+	HOT_LEVELOAD_GENERATORS,
+	HOT_LEVELOAD_FIXEDSIZEGENS,
+	HOT_MAP_RELOAD_WITH_COMPLETIONS,
+	HOT_MAP_INIT,
+
+	HOT_TOTAL
+};
+
+static const char *const rom_hot_label_names[HOT_TOTAL] =
+{
+	"PAGE_A000_ByTileset",
+	"PAGE_C000_ByTileset",
+	"Level_BG_Pages1",
+	"Level_BG_Pages2",
+	"TileLayout_ByTileset",
+	"Palette_By_Tileset",
+	"LevelLoad_ByTileset",
+	"LoadLevel_StoreJctStart",
+	"LeveLoad_Generators",
+	"LeveLoad_FixedSizeGens",
+	"Map_Reload_with_Completions",
+	"Map_Init",
+};
+
+// Per-world labels needed by every world map load, by handle
+#define ROM_WORLDS	9	// W1 to W9; any other world is looked up by name
+
+enum ROM_WORLD_LABELS
+{
+	WORLD_MAP_LAYOUT,
+	WORLD_BYROWTYPE,
+	WORLD_BYSCRCOL,
+	WORLD_OBJSETS,
+	WORLD_LEVELLAYOUT,
+
+	WORLD_LABEL_TOTAL
+};
+
+static const char *const rom_world_label_formats[WORLD_LABEL_TOTAL] =
+{
+	"W%i_Map_Layout",
+	"W%i_ByRowType",
+	"W%i_ByScrCol",
+	"W%i_ObjSets",
+	"W%i_LevelLayout",
+};
+
+static NoDice_label_handle rom_hot_labels[HOT_TOTAL];
+static NoDice_label_handle rom_world_labels[ROM_WORLDS][WORLD_LABEL_TOTAL];
+static int rom_label_handles_ready = 0;
 
 
-// The loaded level memory
+// The loaded level memory and stop reason of the default context
 struct NoDice_level NoDice_the_level = { { 0 } };
+volatile enum RUN6502_STOP_REASON NoDice_Run6502_Stop = RUN6502_STOP_NOTSTOPPED;
+
+// Bumped whenever a PRG refresh changes any bank, since that
+// invalidates checkpoints and recorded generators using the bank
+static unsigned int rom_PRG_serial = 0;
 
-// Required stuff for level loading, not public
-static byte is_loading_level = 0;	// Set to enable any of the following
-static struct NoDice_the_level_generator *cur_gen = NULL, *prev_gen = NULL;
-static unsigned short prev_gen_start_addr = 0x0000;	// Start address of generator; for determining size
+// The default context, used by all of the non-context API
+static struct NoDice_context rom_default_context;
+
+// Level data patched in by NoDice_fast_apply_level (offsets into PRG)
+// which the next build has yet to be checked against
+struct rom_fast_patch
+{
+	int offset, size;
+	unsigned char *data;
+};
+static struct rom_fast_patch *rom_fast_patches = NULL;
+static int rom_fast_patch_count = 0;
+static struct NoDice_context *rom_fast_apply_context = NULL;	// Loads levels as the ROM has them
+static void rom_fast_patches_free();
+
+// Context the 6502 is running on in this thread; Rd6502 and friends
+// have no way to be told, so whatever runs the 6502 must set this!
+static THREAD_LOCAL struct NoDice_context *rom_ctx = &rom_default_context;
 
 
 // Calculate virtual x pixel position of specified video address (non-vertical)
@@ -189,370 +530,2124 @@ static unsigned short vram_virtual_y_v(unsigned short addr)
 }
 
 
-static void prev_gen_patch(int size_offset)
+static void prev_gen_patch(struct NoDice_context *ctx, int size_offset)
 {
+	struct NoDice_the_level_generator *prev_gen = ctx->prev_gen;
+
 	if(prev_gen != NULL)
 	{
 		// Set size on previous generator
-		prev_gen->size = MAKE16(Level_LayPtr_AddrH, Level_LayPtr_AddrL) - prev_gen_start_addr + size_offset;
+		prev_gen->size = MAKE16(Level_LayPtr_AddrH, Level_LayPtr_AddrL) - ctx->prev_gen_start_addr + size_offset;
 
 		// Push to edge of tile
 		prev_gen->xe += (TILESIZE - 1);
 		prev_gen->ye += (TILESIZE - 1);
 
-		prev_gen = NULL;
+		ctx->prev_gen = NULL;
 	}
 }
 
 
-void _rom_free_level_list()
+// Maps the page-aligned range start-end to the given memory; NULL hooks the page
+static void rom_memmap_set(struct NoDice_context *ctx, unsigned int start, unsigned int end, const unsigned char *read, unsigned char *write)
 {
-	struct NoDice_the_level_generator *gen, *next;
+	unsigned int page;
 
-	gen = NoDice_the_level.generators;
-	while(gen != NULL)
+	for(page = start >> MEMMAP_PAGE_SHIFT; page <= (end >> MEMMAP_PAGE_SHIFT); page++)
 	{
-		next = gen->next;
-		free(gen);
-		gen = next;
+		unsigned int offset = (page << MEMMAP_PAGE_SHIFT) - start;
+		struct rom_memmap_page *p = &ctx->memmap[page];
+
+		p->read = (read != NULL) ? (read + offset) : NULL;
+		p->write = (write != NULL) ? (write + offset) : NULL;
+		p->hook = ((read == NULL) ? MEMMAP_HOOK_READ : 0) | ((write == NULL) ? MEMMAP_HOOK_WRITE : 0);
 	}
-	NoDice_the_level.generators = NULL;
+}
 
-	cur_gen = NULL;
-	prev_gen = NULL;
+
+// Stops execution from within the 6502 (a read, write or trap); cutting
+// ICount short gets Loop6502 called as soon as the instruction completes
+static void rom_stop(struct NoDice_context *ctx, enum RUN6502_STOP_REASON reason)
+{
+	*ctx->stop = reason;
+	ctx->CPU_Context.ICount = 0;
 }
 
 
-void Wr6502(register word Addr,register byte Value)
+// Rebuilds the memory map; must be called whenever the banks or
+// is_loading_level change so the fast path stays in step with the
+// full decode in rom_Rd6502_hooked / rom_Wr6502_hooked
+static void rom_memmap_update(struct NoDice_context *ctx)
 {
-	if(is_loading_level)
+	unsigned char *RAM_B = &ctx->_RAM[MEM_A_END - MEM_A_START + 1];
+	int i;
+
+	// Checkpoints are only good as long as every bank the reload
+	// has used so far is unchanged
+	if(ctx->checkpointing)
 	{
-		// Determine if a generator is writing out of bounds
+		for(i = 0; i < 4; i++)
+		{
+			int bank = (int)(((i == 0) ? ctx->_PRG_A : (i == 1) ? ctx->_PRG_B : (i == 2) ? ctx->_PRG_C : ctx->_PRG_D) - _PRG) / MMC3_BANKSIZE;
 
-		// If writing in the address space used by the scratch below
-		// the expanded RAM bank, you're probably out of order!
-		if(Addr >= SCRATCH_START && Addr < MEM_B_START)
-			NoDice_Run6502_Stop = RUN6502_LEVEL_OORW_LOW;
+			ctx->checkpoint_banks[bank >> 3] |= 1 << (bank & 7);
+		}
+	}
 
-		// If writing beyond the sensible end of the tile grid,
-		// mark it as out-of-range-high.  There actually are some
-		// generator layouts that overwrite memory they shouldn't,
-		// but for the sake of legacy compatibility, we're allowing
-		// a user-defined acceptable overrun... ideally this would
-		// not exceed TILEMEM_END, but oh well...
-		else if(Addr > TILEMEM_END && Addr <= NoDice_config.level_range_check_high)
-			NoDice_Run6502_Stop = RUN6502_LEVEL_OORW_HIGH;
+#ifdef DECODE6502
+	// Decode6502 follows the PRG banks; a block still running may not
+	// be mapped any more (or its page may now be hooked)
+	for(i = 0; i < 4; i++)
+	{
+		const unsigned char *bank = (i == 0) ? ctx->_PRG_A : (i == 1) ? ctx->_PRG_B : (i == 2) ? ctx->_PRG_C : ctx->_PRG_D;
 
+		ctx->decode_bank[i] = &_PRG_decoded[bank - _PRG];
+	}
 
-		// This is assuming tile memory grid writes from generators,
-		// but this might not be completely safe...
-		if(Addr >= MEM_B_START && Addr <= MEM_B_END && prev_gen != NULL)
-		{
-			short x, y;
+	ctx->CPU_Context.Dec = NULL;
+#endif
 
-			// Update min/max ranges as needed
-			if(Addr < prev_gen->addr_min)
-				prev_gen->addr_min = Addr;
-			if(Addr > prev_gen->addr_max)
-				prev_gen->addr_max = Addr;
+	// Anything not otherwise mapped (unused space, the page holding
+	// the start of the scratch area, etc.) takes the slow path
+	rom_memmap_set(ctx, 0x0000, 0xFFFF, NULL, NULL);
 
-			if(prev_gen->type != GENTYPE_JCTSTART)
-			{
-				// Check if we've hit a new high or low x/y position
-				x = (!Level_7Vertical) ? vram_virtual_x(Addr) : vram_virtual_x_v(Addr);
-				y = (!Level_7Vertical) ? vram_virtual_y(Addr) : vram_virtual_y_v(Addr);
+	rom_memmap_set(ctx, MEM_A_START, MEM_A_END, ctx->_RAM, ctx->_RAM);
 
-				if(x < prev_gen->xs)
-					prev_gen->xs = x;
-				if(x > prev_gen->xe)
-					prev_gen->xe = x;
+	// While loading a level, writes to the tile memory are captured
+	// for the generators and scratch is readable (writing to it is an
+	// error caught by the slow path)
+	if(ctx->is_loading_level)
+	{
+		unsigned int scratch_page = (SCRATCH_START | MEMMAP_PAGE_MASK) + 1;
 
-				if(y < prev_gen->ys)
-					prev_gen->ys = y;
-				if(y > prev_gen->ye)
-					prev_gen->ye = y;
-			}
+		rom_memmap_set(ctx, scratch_page, SCRATCH_END, &ctx->_PRG_FakeScratch[scratch_page - SCRATCH_START], NULL);
+		rom_memmap_set(ctx, MEM_B_START, MEM_B_END, RAM_B, NULL);
+	}
+	else
+		rom_memmap_set(ctx, MEM_B_START, MEM_B_END, RAM_B, RAM_B);
 
+	// PRG is read-only; writes are either MMC3 commands or errors
+	rom_memmap_set(ctx, PRG_A_START, PRG_A_END, ctx->_PRG_A, NULL);
+	rom_memmap_set(ctx, PRG_B_START, PRG_B_END, ctx->_PRG_B, NULL);
+	rom_memmap_set(ctx, PRG_C_START, PRG_C_END, ctx->_PRG_C, NULL);
+	rom_memmap_set(ctx, PRG_D_START, PRG_D_END, ctx->_PRG_D, NULL);
 
-			// Record generator index onto tile_id_grid (acceptable range only)
-			// This will allow us to later identify what tiles actually belong
-			// to this generator, a finer detection than just the rectangle.
-			if(Addr <= TILEMEM_END)
-				NoDice_the_level.tile_id_grid[Addr - TILEMEM_BASE] = prev_gen->index;
-		}
-	}
+	// Last page holds the interrupt vectors and termination address
+	ctx->memmap[0xFFFF >> MEMMAP_PAGE_SHIFT].hook |= MEMMAP_HOOK_READ;
 
-	if(Addr >= MEM_A_START && Addr <= MEM_A_END)
-		_RAM[Addr - MEM_A_START] = Value;
-	else if(Addr >= MEM_B_START && Addr <= MEM_B_END)
-		_RAM[Addr - MEM_B_START + MEM_A_END + 1] = Value;
-	else if(Addr == MMC3_COMMAND)
-		MMC3_Command = Value;
-	else if(Addr == MMC3_PAGE)
+	// Pages with traps on them need to be checked against trap_bitmap
+	for(i = 0; i < ctx->trap_count; i++)
+		ctx->memmap[ctx->traps[i].addr >> MEMMAP_PAGE_SHIFT].hook |= MEMMAP_HOOK_READ;
+
+	// Recording a generator needs to see every write and every read of
+	// RAM or scratch; PRG is fixed by the replay key, so the only PRG
+	// read it cares about is the opcode fetch at its return address
+	if(ctx->replay_recording)
 	{
-		//printf("*** Page change %s to %i\n", (MMC3_Command == MMC3_8K_TO_PRG_A000) ? "A000" : "C000", Value );
+		for(i = 0; i < (PRG_A_START >> MEMMAP_PAGE_SHIFT); i++)
+			ctx->memmap[i].hook = MEMMAP_HOOK_READ | MEMMAP_HOOK_WRITE;
+
+		ctx->memmap[ctx->replay_return_addr >> MEMMAP_PAGE_SHIFT].hook |= MEMMAP_HOOK_READ;
+	}
+}
 
-		if(MMC3_Command == MMC3_8K_TO_PRG_A000)
-			_PRG_B = &_PRG[Value * MMC3_BANKSIZE];
-		else if(MMC3_Command == MMC3_8K_TO_PRG_C000)
-			_PRG_C = &_PRG[Value * MMC3_BANKSIZE];
-		else
-			fprintf(stderr, "Warning: Unsupported MMC3 command %02X\n", MMC3_Command);
 
-		MMC3_Command = 0;
+// Register a callback to be made whenever the 6502 reads from the
+// address (this includes opcode fetches, so trapping the first byte
+// of a subroutine calls back when it begins executing.)  Callbacks
+// are made before the read is serviced and must not add or remove
+// traps themselves.  Returns 0 if there are too many traps.
+int NoDice_context_trap_add(struct NoDice_context *ctx, unsigned short addr, NoDice_trap_callback callback, void *user)
+{
+	struct rom_trap *trap;
+
+	if(ctx->trap_count >= TRAPS_MAX)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Too many traps registered (limit %i)", TRAPS_MAX);
+		return 0;
 	}
-	else
-		fprintf(stderr, "Warning: Out of range write %04X\n", Addr);
+
+	trap = &ctx->traps[ctx->trap_count++];
+	trap->addr = addr;
+	trap->callback = callback;
+	trap->user = user;
+
+	ctx->trap_bitmap[addr >> 3] |= (1 << (addr & 7));
+
+	if(_PRG != NULL)
+		rom_memmap_update(ctx);
+
+	return 1;
 }
 
-byte Rd6502(register word Addr)
+
+// Removes a trap previously registered with NoDice_context_trap_add
+void NoDice_context_trap_remove(struct NoDice_context *ctx, unsigned short addr, NoDice_trap_callback callback, void *user)
 {
-	if(is_loading_level)
+	int i, still_trapped = 0;
+
+	for(i = 0; i < ctx->trap_count; i++)
 	{
-		if((Addr == LeveLoad_Generators) || (Addr == LeveLoad_FixedSizeGens) || (Addr == LoadLevel_StoreJctStart))
+		struct rom_trap *trap = &ctx->traps[i];
+
+		if(trap->addr == addr && trap->callback == callback && trap->user == user)
 		{
-			// Allocate new generator
-			struct NoDice_the_level_generator *g = (struct NoDice_the_level_generator *)malloc(sizeof(struct NoDice_the_level_generator));
+			// Close the gap
+			memmove(trap, trap + 1, (ctx->trap_count - i - 1) * sizeof(struct rom_trap));
+			ctx->trap_count--;
+			i--;
+		}
+		else if(trap->addr == addr)
+			still_trapped = 1;
+	}
 
-			if(Addr == LeveLoad_Generators)
-			{
-				// Set type
-				g->type = GENTYPE_VARIABLE;
+	if(!still_trapped)
+		ctx->trap_bitmap[addr >> 3] &= ~(1 << (addr & 7));
 
-				// To determine which generator we're executing, the format is:
-				// The upper 3 bits of Temp_Var15 select a multiple of 15
-				// The upper 4 bits of LL_ShapeDef hold an offset
-				// Add those together and subtract 1
-				g->id = ((Temp_Var15 >> 5) * 15) + (LL_ShapeDef >> 4) - 1;
+	if(_PRG != NULL)
+		rom_memmap_update(ctx);
+}
 
-				// p1 is a guarantee, lower 4 bits of LL_ShapeDef, value of 0-15
-				g->p[0] = LL_ShapeDef & 0xF;
 
-				// p2 MAY be used, next byte after the base generator was defined, but not always!
-				g->p[1] = Rd6502(MAKE16(Level_LayPtr_AddrH, Level_LayPtr_AddrL));
-			}
-			else if(Addr == LeveLoad_FixedSizeGens)
-			{
-				// Set type
-				g->type = GENTYPE_FIXED;
+int NoDice_trap_add(unsigned short addr, NoDice_trap_callback callback, void *user)
+{
+	return NoDice_context_trap_add(&rom_default_context, addr, callback, user);
+}
 
-				// To determine which generator we're executing, the format is:
-				// The upper 3 bits of Temp_Var15, shifted down 1
-				// Add LL_ShapeDef
-				g->id = ((Temp_Var15 & 0xE0) >> 1) + LL_ShapeDef;
 
-				// No params (ever?)
-				g->p[0] = 0;
-				g->p[1] = 0;
-			}
-			else
-			{
-				// Set type
-				g->type = GENTYPE_JCTSTART;
+void NoDice_trap_remove(unsigned short addr, NoDice_trap_callback callback, void *user)
+{
+	NoDice_context_trap_remove(&rom_default_context, addr, callback, user);
+}
 
-				// Junction start index (lower 4 bits of Temp_Var15) is the ID
-				g->id = (Temp_Var15 & 0xF);
 
-				// Temp_Var16 is stored in Level_JctYLHStart array
-				g->p[0] = Temp_Var16;
+static void rom_trap_dispatch(struct NoDice_context *ctx, word Addr)
+{
+	int i;
 
-				// LL_ShapeDef is stored in Level_JctXLHStart array
-				g->p[1] = LL_ShapeDef;
+	for(i = 0; i < ctx->trap_count; i++)
+	{
+		if(ctx->traps[i].addr == Addr)
+			ctx->traps[i].callback(ctx, Addr, ctx->traps[i].user);
+	}
+}
 
-				// FIXME: Do we need this too?
-				NoDice_the_level.Level_JctYLHStart[g->id] = Temp_Var16;
-				NoDice_the_level.Level_JctXLHStart[g->id] = LL_ShapeDef;
-			}
 
-			// Assign current address
-			g->addr_start = MAKE16(Map_Tile_AddrH, Map_Tile_AddrL) + TileAddr_Off;
+static void rom_trap_generator(struct NoDice_context *ctx, unsigned short addr, void *user);
 
-			// Terminate list
-			g->next = NULL;
+static void rom_set_loading_level(struct NoDice_context *ctx, byte loading)
+{
+	// Generator capture is a set of traps on the routines that the level
+	// loader calls for each kind of generator; the addresses are kept
+	// since the labels may be re-resolved before the traps are removed
+	int i;
 
-			if(cur_gen == NULL)
-			{
-				g->prev = NULL;
-				NoDice_the_level.generators = g;
-				cur_gen = g;
+	if(loading && !ctx->is_loading_level)
+	{
+		ctx->gen_traps[0] = ctx->LeveLoad_Generators;
+		ctx->gen_traps[1] = ctx->LeveLoad_FixedSizeGens;
+		ctx->gen_traps[2] = ctx->LoadLevel_StoreJctStart;
 
-				// If there's no previous generator, we start on index zero
-				g->index = 0;
-			}
-			else
+		for(i = 0; i < 3; i++)
+		{
+			// Without all three the level would load with generators
+			// missing, so it doesn't load at all
+			if(!NoDice_context_trap_add(ctx, ctx->gen_traps[i], rom_trap_generator, NULL))
 			{
-				// Patch in values for the previous generator
-				// -3 for the same reason as the initial calculation;
-				// we're already that far ahead!
-				prev_gen_patch(-3);
+				snprintf(_error_msg, ERROR_MSG_LEN, "Can't trap the level loader's generators: too many traps registered (limit %i)", TRAPS_MAX);
 
-				g->prev = cur_gen;
-				cur_gen->next = g;
-				cur_gen = cur_gen->next;
+				while(i-- > 0)
+					NoDice_context_trap_remove(ctx, ctx->gen_traps[i], rom_trap_generator, NULL);
 
-				// For all subsequent generators, the index is the previous index + 1
-				g->index = g->prev->index + 1;
+				rom_stop(ctx, RUN6502_INIT_ERROR);
+				loading = 0;
+				break;
 			}
-
-			// Mark start of generator
-			// NOTE: -3 because by the execution flow, by the time it has decided
-			// which routine to call, it has already read in the 3 primary bytes
-			// required by all generators, so the actual start is 3 bytes ago...
-			prev_gen_start_addr = MAKE16(Level_LayPtr_AddrH, Level_LayPtr_AddrL) - 3;
-			prev_gen = g;
-
-			// Reset min/max finders
-			prev_gen->addr_min = 0xFFFF;
-			prev_gen->addr_max = 0x0000;
-			prev_gen->xs = 0xFFFF;
-			prev_gen->ys = 0xFFFF;
-			prev_gen->xe = 0x0000;
-			prev_gen->ye = 0x0000;
 		}
-	}	// is_loading_level
-
-	// 0xFFFC, normally the "RESET" vector, will be used as the termination address
-	if(Addr == 0xFFFC)
-		NoDice_Run6502_Stop = RUN6502_STOP_END;			// Flag execution as terminated
-	else if(Addr >= 0xFFFA)
-		return (Addr & 1) ? 0xFF : 0xF9;	// Handle interrupt vectors with 0xFFF9 (mainly in case of BRK)
-	else if(Addr == 0xFFF9)
-		return 0x40;					// 0xFFF9 will just return RTI
-	else if(Addr >= MEM_A_START && Addr <= MEM_A_END)
-		return _RAM[Addr - MEM_A_START];
-	else if(Addr >= MEM_B_START && Addr <= MEM_B_END)
-		return _RAM[Addr - MEM_B_START + MEM_A_END + 1];
-	else if(Addr >= SCRATCH_START && Addr <= SCRATCH_END && is_loading_level)
-		// Scratch space for modified levels; see defs for SCRATCH_START/END
-		return _PRG_FakeScratch[Addr - SCRATCH_START];
-	else if(Addr >= PRG_A_START && Addr <= PRG_A_END)
-		return _PRG_A[Addr - PRG_A_START];
-	else if(Addr >= PRG_B_START && Addr <= PRG_B_END)
-		return _PRG_B[Addr - PRG_B_START];
-	else if(Addr >= PRG_C_START && Addr <= PRG_C_END)
-		return _PRG_C[Addr - PRG_C_START];
-	else if(Addr >= PRG_D_START && Addr <= PRG_D_END)
-		return _PRG_D[Addr - PRG_D_START];
-	else
-		fprintf(stderr, "Warning: Out of range read %04X\n", Addr);
+	}
+	else if(!loading && ctx->is_loading_level)
+	{
+		for(i = 0; i < 3; i++)
+			NoDice_context_trap_remove(ctx, ctx->gen_traps[i], rom_trap_generator, NULL);
+	}
 
-	return 0xFF;
+	ctx->is_loading_level = loading;
+	rom_memmap_update(ctx);
 }
 
-byte Patch6502(register byte Op,register M6502 *R)
-{
-	// Illegal opcodes are illegal opcodes
-	return 0;
-}
 
-byte Loop6502(register M6502 *R)
+// Takes the next generator from the context's arena; returns NULL
+// if out of memory
+static struct NoDice_the_level_generator *rom_gen_alloc(struct NoDice_context *ctx)
 {
-	// Run until we get a stop reason!
-	return (NoDice_Run6502_Stop == RUN6502_STOP_NOTSTOPPED) ? INT_NONE : INT_QUIT;
+	int block = ctx->gen_used / GEN_BLOCK_SIZE;
+
+	if(block == ctx->gen_block_count)
+	{
+		struct NoDice_the_level_generator **blocks = (struct NoDice_the_level_generator **)realloc(ctx->gen_blocks, (block + 1) * sizeof(struct NoDice_the_level_generator *));
+
+		if(blocks == NULL)
+			return NULL;
+
+		ctx->gen_blocks = blocks;
+
+		if( (blocks[block] = (struct NoDice_the_level_generator *)malloc(GEN_BLOCK_SIZE * sizeof(struct NoDice_the_level_generator))) == NULL)
+			return NULL;
+
+		ctx->gen_block_count++;
+	}
+
+	return &ctx->gen_blocks[block][ctx->gen_used++ % GEN_BLOCK_SIZE];
 }
 
 
-static void rom_Reset6502(int ram_clear)
+// Returns the arena slot the generator occupies, or -1 if it wasn't
+// allocated from the arena (in which case it is malloc'ed, and the
+// level frees it when done with it)
+static int rom_gen_slot(const struct NoDice_context *ctx, const struct NoDice_the_level_generator *gen)
 {
-	// Set up default ROM banks -- _PRG_A and _PRG_D are always (for SMB3) the last two PRG banks
-	// The middle are 00 and 01 until otherwise
-	_PRG_A = &_PRG[PRG_size - (MMC3_BANKSIZE * 2)];
-	_PRG_B = &_PRG[0];
-	_PRG_C = &_PRG[MMC3_BANKSIZE];
-	_PRG_D = &_PRG[PRG_size - (MMC3_BANKSIZE * 1)];
+	int i;
 
-	// Clear RAM
-	if(ram_clear)
-		memset(_RAM, 0, sizeof(_RAM));
+	for(i = 0; i < ctx->gen_block_count; i++)
+	{
+		if(gen >= ctx->gen_blocks[i] && gen < ctx->gen_blocks[i] + GEN_BLOCK_SIZE)
+			return i * GEN_BLOCK_SIZE + (int)(gen - ctx->gen_blocks[i]);
+	}
 
-	// Reset
-	Reset6502(&CPU_Context);
+	return -1;
+}
 
-	// Set stack to RTS to a hardcoded address which will terminate the
-	// execution; RTS goes to address+1, so 0xFFFB will return to
-	// the address 0xFFFC, which would be the Reset vector...
-	_RAM[MEM_A_START + 0x1FE] = 0xFB;	// Low
-	_RAM[MEM_A_START + 0x1FF] = 0xFF;	// High
-	CPU_Context.S = 0xFD;
 
-	// Clear flag for next run
-	NoDice_Run6502_Stop = RUN6502_STOP_NOTSTOPPED;
+static void rom_gen_release(struct NoDice_context *ctx, struct NoDice_the_level_generator *gen)
+{
+	int slot = rom_gen_slot(ctx, gen);
+
+	if(slot < 0)
+		free(gen);
 
-	// Not loading a level unless you say so!
-	is_loading_level = 0;
+	// The most recent allocation can go straight back; anything
+	// else waits for the level's generators to be freed
+	else if(slot == ctx->gen_used - 1)
+		ctx->gen_used--;
 }
 
 
-static int _rom_load_symbols()
+static void rom_free_level_list(struct NoDice_context *ctx)
 {
-	struct ROM_label *label_cur = NULL, *label_next;
-	FILE *rom;
+	struct NoDice_the_level_generator *gen, *next;
 
-	// Free old symbols, if any
-	while(label_cur != NULL)
+	// Arena generators all go at once; only the odd foreign one is freed
+	gen = ctx->level->generators;
+	while(gen != NULL)
 	{
-		label_next = label_cur->next;
-		free(label_cur);
-		label_cur = label_next;
+		next = gen->next;
+		if(rom_gen_slot(ctx, gen) < 0)
+			free(gen);
+		gen = next;
 	}
+	ctx->level->generators = NULL;
+	ctx->gen_used = 0;
 
-	ROM_labels = NULL;
-	label_cur = NULL;
+	ctx->cur_gen = NULL;
+	ctx->prev_gen = NULL;
+}
 
-	// Load FNS file
-	sprintf(_buffer, "%s" EXT_SYMBOLS, NoDice_config.filebase);
-	rom = fopen(_buffer, "r");
 
-	if(rom == NULL)
-	{
-		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to open binary %s", _buffer);
-		return 0;
-	}
+// Frees the level's generators and the arena itself
+static void rom_gen_arena_free(struct NoDice_context *ctx)
+{
+	int i;
 
-	while(fgets(_buffer, BUFFER_LEN, rom) != NULL)
-	{
-		char label[32];
-		unsigned int addr;
+	rom_free_level_list(ctx);
 
-		// Remove any comments
-		char *semi = strchr(_buffer, ';');
-		if(semi != NULL)
-			*semi = '\0';
+	for(i = 0; i < ctx->gen_block_count; i++)
+		free(ctx->gen_blocks[i]);
 
-		// Pull out the label and its assigned address
-		if(sscanf(_buffer, "%31s = $%04X", label, &addr) == 2)
-		{
-			// If sscanf returned 2 fields parsed, we fill in...
-			if(ROM_labels == NULL)
-			{
-				// First label...
-				ROM_labels = (struct ROM_label *)malloc(sizeof(struct ROM_label));
-				label_cur = ROM_labels;
-			}
-			else
-			{
-				// Subsequent labels...
-				label_cur->next = (struct ROM_label *)malloc(sizeof(struct ROM_label));
-				label_cur = label_cur->next;
-			}
+	free(ctx->gen_blocks);
+	ctx->gen_blocks = NULL;
+	ctx->gen_block_count = 0;
+}
 
-			// Terminate the label set thus far
-			label_cur->next = NULL;
 
-			// Copy in the label data
-			strcpy(label_cur->label, label);
-			label_cur->address = (unsigned short)addr;
+void _rom_free_level_list()
+{
+	rom_gen_arena_free(&rom_default_context);
+}
+
+
+// Allocates a generator for adding to the context's level; like those
+// the level loaded with, it's only good until the next level load
+struct NoDice_the_level_generator *NoDice_context_alloc_generator(struct NoDice_context *ctx)
+{
+	struct NoDice_the_level_generator *gen = rom_gen_alloc(ctx);
+
+	if(gen == NULL)
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to allocate generator");
+
+	return gen;
+}
+
+
+// Releases a generator already removed from the context's level
+void NoDice_context_free_generator(struct NoDice_context *ctx, struct NoDice_the_level_generator *gen)
+{
+	rom_gen_release(ctx, gen);
+}
+
+
+struct NoDice_the_level_generator *NoDice_alloc_generator()
+{
+	return NoDice_context_alloc_generator(&rom_default_context);
+}
+
+
+void NoDice_free_generator(struct NoDice_the_level_generator *gen)
+{
+	NoDice_context_free_generator(&rom_default_context, gen);
+}
+
+
+static void rom_Reset6502(struct NoDice_context *ctx, int ram_clear);
+
+static void rom_checkpoints_clear(struct NoDice_context *ctx)
+{
+	ctx->checkpoint_count = 0;
+	ctx->checkpoint_data_size = 0;
+}
+
+
+// Called as each generator begins (before it is captured) while
+// reloading raw data; every CHECKPOINT_INTERVAL generators, snapshots
+// everything the rest of the level load depends on
+static void rom_checkpoint_save(struct NoDice_context *ctx, unsigned short Addr)
+{
+	struct rom_checkpoint *ckpt;
+
+	if(ctx->cur_gen == NULL || ctx->prev_gen == NULL || ((ctx->cur_gen->index + 1) % CHECKPOINT_INTERVAL) != 0)
+		return;
+
+	if(ctx->checkpoint_count == ctx->checkpoint_alloc)
+	{
+		int alloc = ctx->checkpoint_alloc + 16;
+
+		if( (ckpt = (struct rom_checkpoint *)realloc(ctx->checkpoints, alloc * sizeof(struct rom_checkpoint))) == NULL)
+		{
+			// Just do without the rest
+			ctx->checkpointing = 0;
+			return;
+		}
+
+		ctx->checkpoints = ckpt;
+		ctx->checkpoint_alloc = alloc;
+	}
+
+	ckpt = &ctx->checkpoints[ctx->checkpoint_count++];
+
+	// The opcode fetch that tripped the trap already advanced PC
+	ckpt->CPU = ctx->CPU_Context;
+	ckpt->CPU.PC.W = Addr;
+
+	ckpt->_PRG_A = ctx->_PRG_A;
+	ckpt->_PRG_B = ctx->_PRG_B;
+	ckpt->_PRG_C = ctx->_PRG_C;
+	ckpt->_PRG_D = ctx->_PRG_D;
+	ckpt->MMC3_Command = ctx->MMC3_Command;
+	memcpy(ckpt->_RAM, ctx->_RAM, sizeof(ckpt->_RAM));
+
+	memcpy(ckpt->tile_id_grid, ctx->level->tile_id_grid, sizeof(ckpt->tile_id_grid));
+	memcpy(ckpt->Level_JctXLHStart, ctx->level->Level_JctXLHStart, sizeof(ckpt->Level_JctXLHStart));
+	memcpy(ckpt->Level_JctYLHStart, ctx->level->Level_JctYLHStart, sizeof(ckpt->Level_JctYLHStart));
+
+	ckpt->prev_gen = *ctx->prev_gen;
+	ckpt->prev_gen_start_addr = ctx->prev_gen_start_addr;
+
+	ckpt->gen_count = ctx->cur_gen->index + 1;
+	ckpt->cycles_run = ctx->cycles_run;
+	ckpt->data_offset = MAKE16(Level_LayPtr_AddrH, Level_LayPtr_AddrL) - SCRATCH_START;
+}
+
+
+// Finds the last checkpoint still valid for the level data now in the
+// scratch area (size bytes), i.e. the data read before it is unchanged
+static const struct rom_checkpoint *rom_checkpoint_find(struct NoDice_context *ctx, int size)
+{
+	int first_diff = 0, max, i;
+
+	if(ctx->checkpoint_data_size == 0 ||
+		ctx->checkpoint_tileset != ctx->level->tileset->id)
+		return NULL;
+
+	for(i = 0; i < PRG_size / MMC3_BANKSIZE; i++)
+	{
+		if((ctx->checkpoint_banks[i >> 3] & (1 << (i & 7))) && _PRG_banks[i].serial > ctx->checkpoint_PRG_serial)
+			return NULL;
+	}
+
+	max = (size < ctx->checkpoint_data_size) ? size : ctx->checkpoint_data_size;
+	while(first_diff < max && ctx->_PRG_FakeScratch[first_diff] == ctx->checkpoint_data[first_diff])
+		first_diff++;
+
+	for(i = ctx->checkpoint_count - 1; i >= 0; i--)
+	{
+		if(ctx->checkpoints[i].data_offset <= first_diff)
+			return &ctx->checkpoints[i];
+	}
+
+	return NULL;
+}
+
+
+// Puts the 6502 and level back the way they were at the checkpoint,
+// with generators from there on discarded; returns 0 (having changed
+// nothing) if the generator list no longer reaches the checkpoint
+static int rom_checkpoint_restore(struct NoDice_context *ctx, const struct rom_checkpoint *ckpt)
+{
+	struct NoDice_level *level = ctx->level;
+	struct NoDice_the_level_generator *gen = level->generators, *prev, *next;
+	int i, used = 0;
+
+	// Note how much of the arena the generators being kept reach into
+	for(i = 1; gen != NULL; i++)
+	{
+		int slot = rom_gen_slot(ctx, gen);
+
+		if(slot >= used)
+			used = slot + 1;
+
+		if(i >= ckpt->gen_count)
+			break;
+
+		gen = gen->next;
+	}
+
+	if(gen == NULL)
+		return 0;
+
+	// Drop everything the checkpoint hasn't loaded yet; past the kept
+	// generators, the arena is free to be handed out again
+	next = gen->next;
+	while(next != NULL)
+	{
+		struct NoDice_the_level_generator *free_gen = next;
+
+		next = next->next;
+		if(rom_gen_slot(ctx, free_gen) < 0)
+			free(free_gen);
+	}
+	ctx->gen_used = used;
+
+	prev = gen->prev;
+	*gen = ckpt->prev_gen;
+	gen->prev = prev;
+	gen->next = NULL;
+
+	ctx->cur_gen = gen;
+	ctx->prev_gen = gen;
+	ctx->prev_gen_start_addr = ckpt->prev_gen_start_addr;
+
+	memcpy(level->tile_id_grid, ckpt->tile_id_grid, sizeof(level->tile_id_grid));
+	memcpy(level->Level_JctXLHStart, ckpt->Level_JctXLHStart, sizeof(level->Level_JctXLHStart));
+	memcpy(level->Level_JctYLHStart, ckpt->Level_JctYLHStart, sizeof(level->Level_JctYLHStart));
+
+	// Retake this and later checkpoints as the load continues
+	ctx->checkpoint_count = ckpt - ctx->checkpoints;
+
+	rom_Reset6502(ctx, 0);
+	rom_set_loading_level(ctx, 1);
+
+	ctx->CPU_Context = ckpt->CPU;
+	ctx->CPU_Context.Profile = (ctx->profile != NULL);
+	ctx->CPU_Context.User = ctx;
+	ctx->cycles_run = ckpt->cycles_run;
+
+	ctx->_PRG_A = ckpt->_PRG_A;
+	ctx->_PRG_B = ckpt->_PRG_B;
+	ctx->_PRG_C = ckpt->_PRG_C;
+	ctx->_PRG_D = ckpt->_PRG_D;
+	ctx->MMC3_Command = ckpt->MMC3_Command;
+	memcpy(ctx->_RAM, ckpt->_RAM, sizeof(ctx->_RAM));
+
+	rom_memmap_update(ctx);
+
+	return 1;
+}
+
+
+static void rom_replay_flush(struct NoDice_context *ctx)
+{
+	int i;
+
+	for(i = 0; i < REPLAY_BUCKETS; i++)
+	{
+		struct rom_replay_entry *entry = ctx->replay_buckets[i], *next;
+
+		while(entry != NULL)
+		{
+			next = entry->next;
+			free(entry);
+			entry = next;
+		}
+
+		ctx->replay_buckets[i] = NULL;
+	}
+
+	ctx->replay_entry_count = 0;
+}
+
+
+// Drops the recorded generators that ran code from a PRG bank changed
+// since serial: the banks mapped in as they began and any they switched in
+static void rom_replay_invalidate(struct NoDice_context *ctx, unsigned int serial)
+{
+	int i, j;
+
+	for(i = 0; i < REPLAY_BUCKETS; i++)
+	{
+		struct rom_replay_entry **slot = &ctx->replay_buckets[i];
+
+		while(*slot != NULL)
+		{
+			struct rom_replay_entry *entry = *slot;
+			int stale =
+				_PRG_banks[entry->key.bank_A].serial > serial ||
+				_PRG_banks[entry->key.bank_B].serial > serial ||
+				_PRG_banks[entry->key.bank_C].serial > serial ||
+				_PRG_banks[entry->key.bank_D].serial > serial;
+
+			for(j = 0; !stale && j < entry->write_count; j++)
+			{
+				if(entry->writes[j].addr == MMC3_PAGE && _PRG_banks[entry->writes[j].value].serial > serial)
+					stale = 1;
+			}
+
+			if(stale)
+			{
+				*slot = entry->next;
+				free(entry);
+				ctx->replay_entry_count--;
+			}
+			else
+				slot = &entry->next;
+		}
+	}
+}
+
+
+static unsigned int rom_replay_hash(const struct rom_replay_key *key)
+{
+	unsigned int h = key->tileset;
+
+	h = h * 31 + key->type;
+	h = h * 31 + key->id;
+	h = h * 31 + key->p0;
+	h = h * 31 + key->bank_A;
+	h = h * 31 + key->bank_B;
+	h = h * 31 + key->bank_C;
+	h = h * 31 + key->bank_D;
+	h = h * 31 + key->addr_start;
+
+	return h & (REPLAY_BUCKETS - 1);
+}
+
+
+static struct rom_replay_entry **rom_replay_find(struct NoDice_context *ctx, const struct rom_replay_key *key)
+{
+	struct rom_replay_entry **entry = &ctx->replay_buckets[rom_replay_hash(key)];
+
+	while(*entry != NULL && memcmp(&(*entry)->key, key, sizeof(struct rom_replay_key)))
+		entry = &(*entry)->next;
+
+	return entry;
+}
+
+
+// Memory a generator input may come from, without any side effects
+static byte rom_replay_peek(struct NoDice_context *ctx, unsigned short Addr)
+{
+	if(Addr <= MEM_A_END)
+		return ctx->_RAM[Addr - MEM_A_START];
+	else if(Addr >= MEM_B_START)
+		return ctx->_RAM[Addr - MEM_B_START + MEM_A_END + 1];
+	else
+		return ctx->_PRG_FakeScratch[Addr - SCRATCH_START];
+}
+
+
+// Ends recording the current generator; if ok, it's cached for
+// replay, otherwise it's marked as never to be replayed
+static void rom_replay_end(struct NoDice_context *ctx, int ok)
+{
+	struct rom_replay_entry **slot, *entry;
+	int input_count = ok ? ctx->replay_input_count : 0;
+	int write_count = ok ? ctx->replay_write_count : 0;
+
+	ctx->replay_recording = 0;
+	rom_memmap_update(ctx);
+
+	// Replaces anything already recorded for the same key
+	slot = rom_replay_find(ctx, &ctx->replay_rec.key);
+	if(*slot != NULL)
+	{
+		entry = *slot;
+		*slot = entry->next;
+		free(entry);
+		ctx->replay_entry_count--;
+	}
+
+	if(ctx->replay_entry_count >= REPLAY_MAX_ENTRIES)
+		rom_replay_flush(ctx);
+
+	if( (entry = (struct rom_replay_entry *)malloc(sizeof(struct rom_replay_entry) + (input_count + write_count) * sizeof(struct rom_replay_access))) == NULL)
+		return;
+
+	*entry = ctx->replay_rec;
+	entry->impure = !ok;
+	entry->input_count = input_count;
+	entry->write_count = write_count;
+	entry->inputs = (struct rom_replay_access *)(entry + 1);
+	entry->writes = entry->inputs + input_count;
+	memcpy(entry->inputs, ctx->replay_inputs, input_count * sizeof(struct rom_replay_access));
+	memcpy(entry->writes, ctx->replay_writes, write_count * sizeof(struct rom_replay_access));
+
+	if(ok)
+	{
+		entry->out_A = ctx->CPU_Context.A;
+		entry->out_X = ctx->CPU_Context.X;
+		entry->out_Y = ctx->CPU_Context.Y;
+		entry->out_P = ctx->CPU_Context.P;
+		entry->out_S = ctx->CPU_Context.S;
+		entry->out_PC = ctx->replay_return_addr;
+	}
+
+	slot = &ctx->replay_buckets[rom_replay_hash(&entry->key)];
+	entry->next = *slot;
+	*slot = entry;
+	ctx->replay_entry_count++;
+}
+
+
+// Called on every (hooked) read while recording
+static void rom_replay_record_read(struct NoDice_context *ctx, unsigned short Addr)
+{
+	unsigned char bit = 1 << (Addr & 7);
+
+	// Returned to the caller; that's all the generator did
+	if(Addr == ctx->replay_return_addr && ctx->CPU_Context.S == ctx->replay_return_S)
+	{
+		rom_replay_end(ctx, 1);
+		return;
+	}
+
+	// PRG is determined by the key; only RAM and scratch are inputs
+	if(Addr > MEM_B_END || (Addr > MEM_A_END && Addr < SCRATCH_START))
+		return;
+
+	if((ctx->replay_written[Addr >> 3] | ctx->replay_seen[Addr >> 3]) & bit)
+		return;
+
+	// Depending on tiles laid down by earlier generators isn't replayable
+	if(Addr >= MEM_B_START || ctx->replay_input_count == REPLAY_MAX_INPUTS)
+	{
+		rom_replay_end(ctx, 0);
+		return;
+	}
+
+	ctx->replay_seen[Addr >> 3] |= bit;
+	ctx->replay_inputs[ctx->replay_input_count].addr = Addr;
+	ctx->replay_inputs[ctx->replay_input_count].value = rom_replay_peek(ctx, Addr);
+	ctx->replay_input_count++;
+}
+
+
+// Called on every write while recording
+static void rom_replay_record_write(struct NoDice_context *ctx, unsigned short Addr, byte Value)
+{
+	if(ctx->replay_write_count == REPLAY_MAX_WRITES)
+	{
+		rom_replay_end(ctx, 0);
+		return;
+	}
+
+	if(Addr <= MEM_B_END)
+		ctx->replay_written[Addr >> 3] |= 1 << (Addr & 7);
+
+	ctx->replay_writes[ctx->replay_write_count].addr = Addr;
+	ctx->replay_writes[ctx->replay_write_count].value = Value;
+	ctx->replay_write_count++;
+}
+
+
+// Called as a (non-junction) generator begins, after it is captured;
+// if a matching run of the generator is cached, its writes are made
+// and the 6502 is sent back to the caller, otherwise the generator is
+// recorded as it runs
+static void rom_replay_begin(struct NoDice_context *ctx, const struct NoDice_the_level_generator *g)
+{
+	M6502 *R = &ctx->CPU_Context;
+	struct rom_replay_key key;
+	struct rom_replay_entry *entry;
+	int i;
+
+	memset(&key, 0, sizeof(key));
+	key.tileset = Level_Tileset;
+	key.type = g->type;
+	key.id = g->id;
+	key.p0 = g->p[0];
+	key.bank_A = (unsigned char)((ctx->_PRG_A - _PRG) / MMC3_BANKSIZE);
+	key.bank_B = (unsigned char)((ctx->_PRG_B - _PRG) / MMC3_BANKSIZE);
+	key.bank_C = (unsigned char)((ctx->_PRG_C - _PRG) / MMC3_BANKSIZE);
+	key.bank_D = (unsigned char)((ctx->_PRG_D - _PRG) / MMC3_BANKSIZE);
+	key.addr_start = g->addr_start;
+
+	if( (entry = *rom_replay_find(ctx, &key)) != NULL)
+	{
+		if(entry->impure)
+		{
+			ctx->replay_stats.impure++;
+			return;
+		}
+
+		if(entry->in_A == R->A && entry->in_X == R->X && entry->in_Y == R->Y && entry->in_P == R->P && entry->in_S == R->S)
+		{
+			for(i = 0; i < entry->input_count; i++)
+			{
+				if(rom_replay_peek(ctx, entry->inputs[i].addr) != entry->inputs[i].value)
+					break;
+			}
+
+			if(i == entry->input_count)
+			{
+				for(i = 0; i < entry->write_count; i++)
+					Wr6502(entry->writes[i].addr, entry->writes[i].value);
+
+				R->A = entry->out_A;
+				R->X = entry->out_X;
+				R->Y = entry->out_Y;
+				R->P = entry->out_P;
+				R->S = entry->out_S;
+				R->PC.W = entry->out_PC;
+
+				// The opcode being fetched becomes a NOP so execution
+				// carries on from the return address
+				ctx->replay_nop = 1;
+
+				ctx->replay_stats.hits++;
+				return;
+			}
+		}
+	}
+
+	ctx->replay_stats.misses++;
+
+	// Record until it returns to the caller (as stacked by its JSR)
+	memset(&ctx->replay_rec, 0, sizeof(ctx->replay_rec));
+	ctx->replay_rec.key = key;
+	ctx->replay_rec.in_A = R->A;
+	ctx->replay_rec.in_X = R->X;
+	ctx->replay_rec.in_Y = R->Y;
+	ctx->replay_rec.in_P = R->P;
+	ctx->replay_rec.in_S = R->S;
+
+	ctx->replay_return_addr = MAKE16(ctx->_RAM[0x100 + (byte)(R->S + 2)], ctx->_RAM[0x100 + (byte)(R->S + 1)]) + 1;
+	ctx->replay_return_S = R->S + 2;
+
+	memset(ctx->replay_written, 0, sizeof(ctx->replay_written));
+	memset(ctx->replay_seen, 0, sizeof(ctx->replay_seen));
+	ctx->replay_input_count = 0;
+	ctx->replay_write_count = 0;
+
+	ctx->replay_recording = 1;
+	rom_memmap_update(ctx);
+}
+
+
+void NoDice_context_replay_stats(struct NoDice_context *ctx, struct NoDice_replay_stats *stats)
+{
+	*stats = ctx->replay_stats;
+	stats->entries = ctx->replay_entry_count;
+}
+
+
+void NoDice_replay_stats(struct NoDice_replay_stats *stats)
+{
+	NoDice_context_replay_stats(&rom_default_context, stats);
+}
+
+
+static void rom_Wr6502_hooked(struct NoDice_context *ctx, register word Addr, register byte Value)
+{
+	if(ctx->replay_recording)
+		rom_replay_record_write(ctx, Addr, Value);
+
+	if(ctx->is_loading_level)
+	{
+		struct NoDice_the_level_generator *prev_gen = ctx->prev_gen;
+
+		// Determine if a generator is writing out of bounds
+
+		// If writing in the address space used by the scratch below
+		// the expanded RAM bank, you're probably out of order!
+		if(Addr >= SCRATCH_START && Addr < MEM_B_START)
+			rom_stop(ctx, RUN6502_LEVEL_OORW_LOW);
+
+		// If writing beyond the sensible end of the tile grid,
+		// mark it as out-of-range-high.  There actually are some
+		// generator layouts that overwrite memory they shouldn't,
+		// but for the sake of legacy compatibility, we're allowing
+		// a user-defined acceptable overrun... ideally this would
+		// not exceed TILEMEM_END, but oh well...
+		else if(Addr > TILEMEM_END && Addr <= NoDice_config.level_range_check_high)
+			rom_stop(ctx, RUN6502_LEVEL_OORW_HIGH);
+
+
+		// This is assuming tile memory grid writes from generators,
+		// but this might not be completely safe...
+		if(Addr >= MEM_B_START && Addr <= MEM_B_END && prev_gen != NULL)
+		{
+			short x, y;
+
+			// Update min/max ranges as needed
+			if(Addr < prev_gen->addr_min)
+				prev_gen->addr_min = Addr;
+			if(Addr > prev_gen->addr_max)
+				prev_gen->addr_max = Addr;
+
+			if(prev_gen->type != GENTYPE_JCTSTART)
+			{
+				// Check if we've hit a new high or low x/y position
+				x = (!Level_7Vertical) ? vram_virtual_x(Addr) : vram_virtual_x_v(Addr);
+				y = (!Level_7Vertical) ? vram_virtual_y(Addr) : vram_virtual_y_v(Addr);
+
+				if(x < prev_gen->xs)
+					prev_gen->xs = x;
+				if(x > prev_gen->xe)
+					prev_gen->xe = x;
+
+				if(y < prev_gen->ys)
+					prev_gen->ys = y;
+				if(y > prev_gen->ye)
+					prev_gen->ye = y;
+			}
+
+
+			// Record generator index onto tile_id_grid (acceptable range only)
+			// This will allow us to later identify what tiles actually belong
+			// to this generator, a finer detection than just the rectangle.
+			if(Addr <= TILEMEM_END)
+				ctx->level->tile_id_grid[Addr - TILEMEM_BASE] = prev_gen->index;
+		}
+	}
+
+	if(Addr >= MEM_A_START && Addr <= MEM_A_END)
+		ctx->_RAM[Addr - MEM_A_START] = Value;
+	else if(Addr >= MEM_B_START && Addr <= MEM_B_END)
+		ctx->_RAM[Addr - MEM_B_START + MEM_A_END + 1] = Value;
+	else if(Addr == MMC3_COMMAND)
+		ctx->MMC3_Command = Value;
+	else if(Addr == MMC3_PAGE)
+	{
+		//printf("*** Page change %s to %i\n", (MMC3_Command == MMC3_8K_TO_PRG_A000) ? "A000" : "C000", Value );
+
+		if(ctx->MMC3_Command == MMC3_8K_TO_PRG_A000)
+			ctx->_PRG_B = &_PRG[Value * MMC3_BANKSIZE];
+		else if(ctx->MMC3_Command == MMC3_8K_TO_PRG_C000)
+			ctx->_PRG_C = &_PRG[Value * MMC3_BANKSIZE];
+		else
+			fprintf(stderr, "Warning: Unsupported MMC3 command %02X\n", ctx->MMC3_Command);
+
+		ctx->MMC3_Command = 0;
+
+		rom_memmap_update(ctx);
+	}
+	else
+		fprintf(stderr, "Warning: Out of range write %04X\n", Addr);
+}
+
+
+// Generator capture; trapped on LeveLoad_Generators, LeveLoad_FixedSizeGens
+// and LoadLevel_StoreJctStart while loading a level
+static void rom_trap_generator(struct NoDice_context *ctx, unsigned short Addr, void *user)
+{
+	struct NoDice_level *level = ctx->level;
+	struct NoDice_the_level_generator *g;
+
+	// Whatever was being recorded didn't return before the next
+	// generator, so it isn't something that can be replayed
+	if(ctx->replay_recording)
+		rom_replay_end(ctx, 0);
+
+	if(ctx->checkpointing)
+		rom_checkpoint_save(ctx, Addr);
+
+	// Allocate new generator
+	if( (g = rom_gen_alloc(ctx)) == NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to allocate generator");
+		rom_stop(ctx, RUN6502_INIT_ERROR);
+		return;
+	}
+
+	if(Addr == ctx->LeveLoad_Generators)
+	{
+		// Set type
+		g->type = GENTYPE_VARIABLE;
+
+		// To determine which generator we're executing, the format is:
+		// The upper 3 bits of Temp_Var15 select a multiple of 15
+		// The upper 4 bits of LL_ShapeDef hold an offset
+		// Add those together and subtract 1
+		g->id = ((Temp_Var15 >> 5) * 15) + (LL_ShapeDef >> 4) - 1;
+
+		// p1 is a guarantee, lower 4 bits of LL_ShapeDef, value of 0-15
+		g->p[0] = LL_ShapeDef & 0xF;
+
+		// p2 MAY be used, next byte after the base generator was defined, but not always!
+		g->p[1] = Rd6502(MAKE16(Level_LayPtr_AddrH, Level_LayPtr_AddrL));
+	}
+	else if(Addr == ctx->LeveLoad_FixedSizeGens)
+	{
+		// Set type
+		g->type = GENTYPE_FIXED;
+
+		// To determine which generator we're executing, the format is:
+		// The upper 3 bits of Temp_Var15, shifted down 1
+		// Add LL_ShapeDef
+		g->id = ((Temp_Var15 & 0xE0) >> 1) + LL_ShapeDef;
+
+		// No params (ever?)
+		g->p[0] = 0;
+		g->p[1] = 0;
+	}
+	else
+	{
+		// Set type
+		g->type = GENTYPE_JCTSTART;
+
+		// Junction start index (lower 4 bits of Temp_Var15) is the ID
+		g->id = (Temp_Var15 & 0xF);
+
+		// Temp_Var16 is stored in Level_JctYLHStart array
+		g->p[0] = Temp_Var16;
+
+		// LL_ShapeDef is stored in Level_JctXLHStart array
+		g->p[1] = LL_ShapeDef;
+
+		// FIXME: Do we need this too?
+		level->Level_JctYLHStart[g->id] = Temp_Var16;
+		level->Level_JctXLHStart[g->id] = LL_ShapeDef;
+	}
+
+	// Assign current address
+	g->addr_start = MAKE16(Map_Tile_AddrH, Map_Tile_AddrL) + TileAddr_Off;
+
+	// Terminate list
+	g->next = NULL;
+
+	if(ctx->cur_gen == NULL)
+	{
+		g->prev = NULL;
+		level->generators = g;
+		ctx->cur_gen = g;
+
+		// If there's no previous generator, we start on index zero
+		g->index = 0;
+	}
+	else
+	{
+		// Patch in values for the previous generator
+		// -3 for the same reason as the initial calculation;
+		// we're already that far ahead!
+		prev_gen_patch(ctx, -3);
+
+		g->prev = ctx->cur_gen;
+		ctx->cur_gen->next = g;
+		ctx->cur_gen = ctx->cur_gen->next;
+
+		// For all subsequent generators, the index is the previous index + 1
+		g->index = g->prev->index + 1;
+	}
+
+	// Mark start of generator
+	// NOTE: -3 because by the execution flow, by the time it has decided
+	// which routine to call, it has already read in the 3 primary bytes
+	// required by all generators, so the actual start is 3 bytes ago...
+	ctx->prev_gen_start_addr = MAKE16(Level_LayPtr_AddrH, Level_LayPtr_AddrL) - 3;
+	ctx->prev_gen = g;
+
+	// Reset min/max finders
+	g->addr_min = 0xFFFF;
+	g->addr_max = 0x0000;
+	g->xs = 0xFFFF;
+	g->ys = 0xFFFF;
+	g->xe = 0x0000;
+	g->ye = 0x0000;
+
+#ifdef PROFILE6502
+	if(ctx->profile != NULL)
+	{
+		if( (ctx->profile_gen = _profile_gen_index(ctx->profile, Level_Tileset, g->type, g->id)) >= 0)
+		{
+			ctx->profile->gens[ctx->profile_gen].calls++;
+			ctx->profile_gen_S = ctx->CPU_Context.S;
+		}
+	}
+#endif
+
+	// A replayed generator runs no 6502 code, so none of its cost would
+	// be counted; while profiling, every generator really runs
+	if(g->type != GENTYPE_JCTSTART && ctx->profile == NULL)
+		rom_replay_begin(ctx, g);
+}
+
+
+static byte rom_Rd6502_hooked(struct NoDice_context *ctx, register word Addr)
+{
+	// Traps on this address?
+	if(ctx->trap_bitmap[Addr >> 3] & (1 << (Addr & 7)))
+	{
+		rom_trap_dispatch(ctx, Addr);
+
+		if(ctx->replay_nop)
+		{
+			ctx->replay_nop = 0;
+			return 0xEA;
+		}
+	}
+
+	if(ctx->replay_recording)
+		rom_replay_record_read(ctx, Addr);
+
+	// 0xFFFC, normally the "RESET" vector, will be used as the termination address
+	if(Addr == 0xFFFC)
+		rom_stop(ctx, RUN6502_STOP_END);			// Flag execution as terminated
+	else if(Addr >= 0xFFFA)
+		return (Addr & 1) ? 0xFF : 0xF9;	// Handle interrupt vectors with 0xFFF9 (mainly in case of BRK)
+	else if(Addr == 0xFFF9)
+		return 0x40;					// 0xFFF9 will just return RTI
+	else if(Addr >= MEM_A_START && Addr <= MEM_A_END)
+		return ctx->_RAM[Addr - MEM_A_START];
+	else if(Addr >= MEM_B_START && Addr <= MEM_B_END)
+		return ctx->_RAM[Addr - MEM_B_START + MEM_A_END + 1];
+	else if(Addr >= SCRATCH_START && Addr <= SCRATCH_END && ctx->is_loading_level)
+		// Scratch space for modified levels; see defs for SCRATCH_START/END
+		return ctx->_PRG_FakeScratch[Addr - SCRATCH_START];
+	else if(Addr >= PRG_A_START && Addr <= PRG_A_END)
+		return ctx->_PRG_A[Addr - PRG_A_START];
+	else if(Addr >= PRG_B_START && Addr <= PRG_B_END)
+		return ctx->_PRG_B[Addr - PRG_B_START];
+	else if(Addr >= PRG_C_START && Addr <= PRG_C_END)
+		return ctx->_PRG_C[Addr - PRG_C_START];
+	else if(Addr >= PRG_D_START && Addr <= PRG_D_END)
+		return ctx->_PRG_D[Addr - PRG_D_START];
+	else
+		fprintf(stderr, "Warning: Out of range read %04X\n", Addr);
+
+	return 0xFF;
+}
+
+void Wr6502(register word Addr,register byte Value)
+{
+	struct NoDice_context *ctx = rom_ctx;
+	struct rom_memmap_page *page = &ctx->memmap[Addr >> MEMMAP_PAGE_SHIFT];
+
+	if(!(page->hook & MEMMAP_HOOK_WRITE))
+		page->write[Addr & MEMMAP_PAGE_MASK] = Value;
+	else
+		rom_Wr6502_hooked(ctx, Addr, Value);
+}
+
+byte Rd6502(register word Addr)
+{
+	struct NoDice_context *ctx = rom_ctx;
+	const struct rom_memmap_page *page = &ctx->memmap[Addr >> MEMMAP_PAGE_SHIFT];
+
+	if(!(page->hook & MEMMAP_HOOK_READ))
+		return page->read[Addr & MEMMAP_PAGE_MASK];
+
+	return rom_Rd6502_hooked(ctx, Addr);
+}
+
+#ifdef DECODE6502
+// Whether the opcode may go anywhere but the next instruction (branch,
+// JMP, JSR, RTS, RTI or BRK)
+static int rom_opcode_is_jump(unsigned char op)
+{
+	return ((op & 0x1F) == 0x10) || op == 0x4C || op == 0x6C || op == 0x20 || op == 0x60 || op == 0x40 || op == 0x00;
+}
+
+
+// Pre-decodes every instruction in one PRG bank.  A block is a basic
+// block: it runs on from each instruction to the next until a branch or
+// jump, and also ends before anything that isn't decoded and at the end
+// of each memory map page (the next page may be hooked, which Decode6502
+// only checks where a block starts.)
+static void rom_decode_PRG_bank(int bank)
+{
+	const unsigned char *PRG = &_PRG[bank * MMC3_BANKSIZE];
+	Dec6502 *decoded = &_PRG_decoded[bank * MMC3_BANKSIZE];
+	int i;
+
+	for(i = 0; i < MMC3_BANKSIZE; i++)
+	{
+		Dec6502 *dec = &decoded[i];
+		unsigned char len = rom_opcode_length[PRG[i]];
+
+		// Nothing reaching into the next page
+		if((i & ~MEMMAP_PAGE_MASK) != ((i + len - 1) & ~MEMMAP_PAGE_MASK))
+			len = 0;
+
+		dec->Op = PRG[i];
+		dec->Len = len;
+		dec->Arg.B.l = (len > 1) ? PRG[i + 1] : 0;
+		dec->Arg.B.h = (len > 2) ? PRG[i + 2] : 0;
+	}
+
+	for(i = 0; i < MMC3_BANKSIZE; i++)
+	{
+		Dec6502 *dec = &decoded[i];
+		int next = i + dec->Len;
+
+		dec->End = rom_opcode_is_jump(dec->Op) || !(next & MEMMAP_PAGE_MASK) || decoded[next].Len == 0;
+	}
+}
+
+
+// Pre-decodes every instruction in PRG; PRG is read-only, so an
+// instruction at a given bank and address is always the same.  Like PRG,
+// the table is rebuilt in place on refresh as contexts point into it.
+static int rom_decode_PRG()
+{
+	int bank;
+
+	if(_PRG_decoded == NULL && (_PRG_decoded = (Dec6502 *)malloc(PRG_size * sizeof(Dec6502))) == NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to allocate PRG decode table");
+		return 0;
+	}
+
+	for(bank = 0; bank < PRG_size / MMC3_BANKSIZE; bank++)
+		rom_decode_PRG_bank(bank);
+
+	return 1;
+}
+
+
+// Hands the core the predecoded block at PC so it can skip Rd6502 for
+// its opcodes and operands.  On a page hooked for reads that's only if
+// nothing the block might run is trapped or up against the fake vectors
+// at the top of memory, and never while recording a generator (whose
+// return address is on a hooked page.)
+const Dec6502 *Decode6502(register M6502 *R)
+{
+	struct NoDice_context *ctx = (struct NoDice_context *)R->User;
+	word PC = R->PC.W;
+	const Dec6502 *dec, *cur;
+	int i;
+
+	if(PC < PRG_A_START || (dec = &ctx->decode_bank[(PC - PRG_A_START) >> 13][PC & (MMC3_BANKSIZE - 1)])->Len == 0)
+		return NULL;
+
+	if(!(ctx->memmap[PC >> MEMMAP_PAGE_SHIFT].hook & MEMMAP_HOOK_READ))
+		return dec;
+
+	if(ctx->replay_recording)
+		return NULL;
+
+	for(cur = dec; ; cur += cur->Len)
+	{
+		for(i = 0; i < cur->Len; i++)
+		{
+			word addr = PC + (word)(cur - dec) + i;
+
+			if(addr >= 0xFFF9 || (ctx->trap_bitmap[addr >> 3] & (1 << (addr & 7))))
+				return NULL;
+		}
+
+		if(cur->End)
+			return dec;
+	}
+}
+#endif
+
+
+#ifdef PROFILE6502
+void Profile6502(register M6502 *R, word PC, byte Cycles)
+{
+	struct NoDice_context *ctx = (struct NoDice_context *)R->User;
+	struct NoDice_profile *profile = ctx->profile;
+	int slot;
+
+	if(PC >= PRG_A_START)
+	{
+		const unsigned char *bank = ((PC < PRG_B_START) ? ctx->_PRG_A : (PC < PRG_C_START) ? ctx->_PRG_B : (PC < PRG_D_START) ? ctx->_PRG_C : ctx->_PRG_D);
+
+		slot = (bank - _PRG) + (PC & (MMC3_BANKSIZE - 1));
+		profile->bank_window[(bank - _PRG) / MMC3_BANKSIZE] = PC & ~(MMC3_BANKSIZE - 1);
+	}
+	else
+		slot = PRG_size + PC;
+
+	profile->instructions[slot]++;
+	profile->cycles[slot] += Cycles;
+
+	// The generator's RTS takes S back above where it was called
+	if(ctx->profile_gen >= 0)
+	{
+		if(R->S > ctx->profile_gen_S)
+			ctx->profile_gen = -1;
+		else
+		{
+			profile->gens[ctx->profile_gen].instructions++;
+			profile->gens[ctx->profile_gen].cycles += Cycles;
+		}
+	}
+}
+#endif
+
+
+// Starts counting what the context's 6502 runs into profile, or stops
+// if NULL; see NoDice_profile_report().  Only available if built with
+// PROFILE6502.  Generators aren't replayed from the cache meanwhile, so
+// every call's cost is counted.
+void NoDice_context_set_profile(struct NoDice_context *ctx, struct NoDice_profile *profile)
+{
+	ctx->profile = profile;
+	ctx->profile_gen = -1;
+#ifdef PROFILE6502
+	ctx->CPU_Context.Profile = (profile != NULL);
+#endif
+}
+
+
+void NoDice_set_profile(struct NoDice_profile *profile)
+{
+	NoDice_context_set_profile(&rom_default_context, profile);
+}
+
+
+byte Patch6502(register byte Op,register M6502 *R)
+{
+	// Illegal opcodes are illegal opcodes
+	return 0;
+}
+
+// Called every CORE_BUDGET_PERIOD cycles, or right after an instruction
+// that stopped execution (see rom_stop)
+byte Loop6502(register M6502 *R)
+{
+	struct NoDice_context *ctx = (struct NoDice_context *)R->User;
+
+	// Anything that runs past its budget is assumed to be stuck; as it
+	// is counted in cycles, that's the same on every machine.  Each call
+	// is one IPeriod on: the cycles the last instruction ran over are
+	// carried into the next period's ICount, so they're counted there
+	ctx->cycles_run += R->IPeriod;
+	if(*ctx->stop == RUN6502_STOP_NOTSTOPPED && ctx->cycles_run > NoDice_config.core6502_budget)
+		*ctx->stop = RUN6502_TIMEOUT;
+
+	// Run until we get a stop reason!
+	return (*ctx->stop == RUN6502_STOP_NOTSTOPPED) ? INT_NONE : INT_QUIT;
+}
+
+
+static void rom_Reset6502(struct NoDice_context *ctx, int ram_clear)
+{
+	// Nothing half-run carries over
+	ctx->replay_recording = 0;
+	ctx->replay_nop = 0;
+	ctx->profile_gen = -1;
+
+	// Set up default ROM banks -- _PRG_A and _PRG_D are always (for SMB3) the last two PRG banks
+	// The middle are 00 and 01 until otherwise
+	ctx->_PRG_A = &_PRG[PRG_size - (MMC3_BANKSIZE * 2)];
+	ctx->_PRG_B = &_PRG[0];
+	ctx->_PRG_C = &_PRG[MMC3_BANKSIZE];
+	ctx->_PRG_D = &_PRG[PRG_size - (MMC3_BANKSIZE * 1)];
+
+	// Not loading a level unless you say so!  (Also maps the
+	// banks above, which Reset6502 needs to fetch the vector)
+	rom_set_loading_level(ctx, 0);
+
+	// Clear RAM
+	if(ram_clear)
+		memset(ctx->_RAM, 0, sizeof(ctx->_RAM));
+
+	// This context is the one running now
+	rom_ctx = ctx;
+	ctx->CPU_Context.User = ctx;
+
+	// Reset; Loop6502 is only called every so often to check the budget
+	ctx->CPU_Context.IPeriod = CORE_BUDGET_PERIOD;
+	ctx->cycles_run = 0;
+	Reset6502(&ctx->CPU_Context);
+
+	// Set stack to RTS to a hardcoded address which will terminate the
+	// execution; RTS goes to address+1, so 0xFFFB will return to
+	// the address 0xFFFC, which would be the Reset vector...
+	ctx->_RAM[MEM_A_START + 0x1FE] = 0xFB;	// Low
+	ctx->_RAM[MEM_A_START + 0x1FF] = 0xFF;	// High
+	ctx->CPU_Context.S = 0xFD;
+
+	// Clear flag for next run
+	*ctx->stop = RUN6502_STOP_NOTSTOPPED;
+}
+
+
+// Prepares a context for use; level and stop are where it keeps the
+// loaded level and stop reason
+static void rom_context_init(struct NoDice_context *ctx, struct NoDice_level *level, volatile enum RUN6502_STOP_REASON *stop)
+{
+	ctx->level = level;
+	ctx->stop = stop;
+
+	rom_Reset6502(ctx, 1);
+}
+
+
+struct NoDice_context *NoDice_context_create()
+{
+	struct NoDice_context *ctx = (struct NoDice_context *)calloc(1, sizeof(struct NoDice_context));
+	struct NoDice_context *running = rom_ctx;
+
+	if(ctx == NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to allocate context");
+		return NULL;
+	}
+
+	rom_context_init(ctx, &ctx->own_level, &ctx->own_stop);
+
+	// Initialization reset the new context, don't leave it running
+	rom_ctx = running;
+
+	return ctx;
+}
+
+
+void NoDice_context_destroy(struct NoDice_context *ctx)
+{
+	if(ctx == NULL || ctx == &rom_default_context)
+		return;
+
+	rom_gen_arena_free(ctx);
+	free(ctx->checkpoints);
+	rom_replay_flush(ctx);
+
+	if(rom_ctx == ctx)
+		rom_ctx = &rom_default_context;
+
+	free(ctx);
+}
+
+
+struct NoDice_context *NoDice_context_default()
+{
+	return &rom_default_context;
+}
+
+
+struct NoDice_level *NoDice_context_level(struct NoDice_context *ctx)
+{
+	return ctx->level;
+}
+
+
+enum RUN6502_STOP_REASON NoDice_context_stop_reason(struct NoDice_context *ctx)
+{
+	return *ctx->stop;
+}
+
+
+// Sets the stop reason; may be called from another thread to halt the
+// 6502, which notices within CORE_BUDGET_PERIOD cycles
+void NoDice_context_stop(struct NoDice_context *ctx, enum RUN6502_STOP_REASON reason)
+{
+	*ctx->stop = reason;
+}
+
+
+const char *NoDice_stop_reason_string(enum RUN6502_STOP_REASON reason)
+{
+	static const char *reasons[] =
+	{
+		// Core triggered
+		"Error??  6502 apparently still running!",	// RUN6502_STOP_NOTSTOPPED (shouldn't be used)
+		"No apparent error",					// RUN6502_STOP_END (good day, shouldn't be used either)
+		"Internal error",						// RUN6502_INIT_ERROR
+		"Generator wrote out of tile memory bounds (low, top/left)",	// RUN6502_LEVEL_OORW_LOW
+		"Generator wrote out of tile memory bounds (high, bottom/right)",	// RUN6502_LEVEL_OORW_HIGH
+		"A generator appeared to be too large",		// RUN6502_GENERATOR_TOO_LARGE
+
+		// Externally triggered
+		"6502 core appears to have frozen (NOTE: May have to change config \"corebudget\")",	// RUN6502_TIMEOUT
+		"Did not return with the expected number of generators",	// RUN6502_GENGENCOUNT_MISMATCH
+	};
+
+	if((unsigned int)reason >= sizeof(reasons) / sizeof(reasons[0]))
+		return "Unknown error";
+
+	return reasons[reason];
+}
+
+
+static unsigned int rom_label_hash(const char *label)
+{
+	// FNV-1a
+	unsigned int hash = 2166136261u;
+
+	while(*label != '\0')
+		hash = (hash ^ (unsigned char)*label++) * 16777619u;
+
+	return hash;
+}
+
+
+// Returns the index of the label, or -1 if it isn't in the FNS
+static int rom_label_find(const char *label)
+{
+	int i;
+
+	if(ROM_label_hash_size == 0)
+		return -1;
+
+	for(i = ROM_label_hash[rom_label_hash(label) & (ROM_label_hash_size - 1)]; i >= 0; i = ROM_labels[i].hash_next)
+	{
+		if(!strcmp(ROM_labels[i].label, label))
+			return i;
+	}
+
+	return -1;
+}
+
+
+static int rom_label_addr_compare(const void *a, const void *b)
+{
+	int ia = *(const int *)a, ib = *(const int *)b;
+
+	if(ROM_labels[ia].address != ROM_labels[ib].address)
+		return (ROM_labels[ia].address < ROM_labels[ib].address) ? -1 : 1;
+
+	// Keep FNS order among labels at the same address
+	return ia - ib;
+}
+
+
+static void rom_labels_free()
+{
+	free(ROM_labels);
+	free(ROM_label_hash);
+	free(ROM_labels_by_addr);
+
+	ROM_labels = NULL;
+	ROM_label_hash = NULL;
+	ROM_labels_by_addr = NULL;
+	ROM_label_count = 0;
+	ROM_label_alloc = 0;
+	ROM_label_hash_size = 0;
+}
+
+
+// Builds the hash and address index over the labels loaded so far
+static int rom_labels_index()
+{
+	int i;
+
+	for(ROM_label_hash_size = 256; ROM_label_hash_size < ROM_label_count * 2; ROM_label_hash_size *= 2)
+		;
+
+	ROM_label_hash = (int *)malloc(ROM_label_hash_size * sizeof(int));
+	ROM_labels_by_addr = (int *)malloc((ROM_label_count > 0 ? ROM_label_count : 1) * sizeof(int));
+
+	if(ROM_label_hash == NULL || ROM_labels_by_addr == NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to allocate symbol table");
+		rom_labels_free();
+		return 0;
+	}
+
+	for(i = 0; i < ROM_label_hash_size; i++)
+		ROM_label_hash[i] = -1;
+
+	// Inserted last to first so, on a duplicate, the first in the FNS
+	// is found first (as it always has been)
+	for(i = ROM_label_count - 1; i >= 0; i--)
+	{
+		unsigned int bucket = rom_label_hash(ROM_labels[i].label) & (ROM_label_hash_size - 1);
+
+		ROM_labels[i].hash_next = ROM_label_hash[bucket];
+		ROM_label_hash[bucket] = i;
+	}
+
+	for(i = 0; i < ROM_label_count; i++)
+		ROM_labels_by_addr[i] = i;
+
+	qsort(ROM_labels_by_addr, ROM_label_count, sizeof(int), rom_label_addr_compare);
+
+	return 1;
+}
+
+
+// Looks up every handle's label again; the first time through, gets
+// the handles for the labels used on every level load
+static int rom_label_handles_resolve()
+{
+	int i, w;
+
+	if(!rom_label_handles_ready)
+	{
+		char label[32];
+
+		for(i = 0; i < HOT_TOTAL; i++)
+		{
+			if( (rom_hot_labels[i] = NoDice_get_label_handle(rom_hot_label_names[i])) < 0)
+				return 0;
+		}
+
+		for(w = 0; w < ROM_WORLDS; w++)
+		{
+			for(i = 0; i < WORLD_LABEL_TOTAL; i++)
+			{
+				snprintf(label, sizeof(label), rom_world_label_formats[i], w + 1);
+				if( (rom_world_labels[w][i] = NoDice_get_label_handle(label)) < 0)
+					return 0;
+			}
+		}
+
+		rom_label_handles_ready = 1;
+	}
+
+	for(i = 0; i < ROM_label_handle_count; i++)
+	{
+		int index = rom_label_find(ROM_label_handles[i].label);
+
+		ROM_label_handles[i].address = (index >= 0) ? ROM_labels[index].address : 0xFFFF;
+	}
+
+	return 1;
+}
+
+
+// Hashes the FNS contents; returns 0 if it couldn't be read
+static int rom_symbol_fns_hash(unsigned int *hash)
+{
+	unsigned char chunk[16384];
+	FILE *fns;
+	int read_amt, i, result;
+
+	*hash = 2166136261u;
+
+	sprintf(_buffer, "%s" EXT_SYMBOLS, NoDice_config.filebase);
+	if( (fns = fopen(_buffer, "rb")) == NULL)
+		return 0;
+
+	while( (read_amt = (int)fread(chunk, 1, sizeof(chunk), fns)) > 0)
+	{
+		for(i = 0; i < read_amt; i++)
+			*hash = (*hash ^ chunk[i]) * 16777619u;
+	}
+
+	result = !ferror(fns);
+	fclose(fns);
+
+	return result;
+}
+
+
+// Fills in the header for the FNS as it is now; returns 0 if the FNS
+// couldn't be read
+static int rom_symbol_cache_header(struct rom_symbol_cache_header *header, const struct stat *fns_stat)
+{
+	memset(header, 0, sizeof(struct rom_symbol_cache_header));
+	memcpy(header->magic, SYMBOL_CACHE_MAGIC, sizeof(header->magic));
+	header->header_size = sizeof(struct rom_symbol_cache_header);
+	header->label_size = sizeof(struct ROM_label);
+	header->fns_size = (unsigned int)fns_stat->st_size;
+
+	return rom_symbol_fns_hash(&header->fns_hash);
+}
+
+
+// Loads the symbol table from the cache if it is good for the FNS;
+// returns 0 (with nothing loaded) if not
+static int rom_symbol_cache_load(const struct stat *fns_stat)
+{
+	struct rom_symbol_cache_header expect, header;
+	FILE *cache;
+	int i, good = 0;
+
+	if(!rom_symbol_cache_header(&expect, fns_stat))
+		return 0;
+
+	sprintf(_buffer, "%s" EXT_SYMBOL_CACHE, NoDice_config.filebase);
+	if( (cache = fopen(_buffer, "rb")) == NULL)
+		return 0;
+
+	if(fread(&header, sizeof(header), 1, cache) == 1 &&
+		!memcmp(header.magic, expect.magic, sizeof(header.magic)) &&
+		header.header_size == expect.header_size && header.label_size == expect.label_size &&
+		header.fns_size == expect.fns_size && header.fns_hash == expect.fns_hash &&
+		header.label_count >= 0 && header.hash_size >= 256 && (header.hash_size & (header.hash_size - 1)) == 0)
+	{
+		ROM_labels = (struct ROM_label *)malloc((header.label_count > 0 ? header.label_count : 1) * sizeof(struct ROM_label));
+		ROM_label_hash = (int *)malloc(header.hash_size * sizeof(int));
+		ROM_labels_by_addr = (int *)malloc((header.label_count > 0 ? header.label_count : 1) * sizeof(int));
+
+		if(ROM_labels != NULL && ROM_label_hash != NULL && ROM_labels_by_addr != NULL &&
+			fread(ROM_labels, sizeof(struct ROM_label), header.label_count, cache) == (size_t)header.label_count &&
+			fread(ROM_label_hash, sizeof(int), header.hash_size, cache) == (size_t)header.hash_size &&
+			fread(ROM_labels_by_addr, sizeof(int), header.label_count, cache) == (size_t)header.label_count &&
+			fgetc(cache) == EOF)
+		{
+			ROM_label_count = ROM_label_alloc = header.label_count;
+			ROM_label_hash_size = header.hash_size;
+			good = 1;
+
+			// Cheap next to parsing; a damaged cache mustn't send us off the end
+			for(i = 0; good && i < ROM_label_count; i++)
+			{
+				if(ROM_labels[i].hash_next < -1 || ROM_labels[i].hash_next >= ROM_label_count ||
+					ROM_labels_by_addr[i] < 0 || ROM_labels_by_addr[i] >= ROM_label_count ||
+					memchr(ROM_labels[i].label, '\0', sizeof(ROM_labels[i].label)) == NULL)
+					good = 0;
+			}
+
+			for(i = 0; good && i < ROM_label_hash_size; i++)
+			{
+				if(ROM_label_hash[i] < -1 || ROM_label_hash[i] >= ROM_label_count)
+					good = 0;
+			}
+		}
+	}
+
+	fclose(cache);
+
+	if(!good)
+		rom_labels_free();
+
+	return good;
+}
+
+
+// Writes the symbol table to the cache; it's only an optimization, so
+// failing to (e.g. read-only directory) isn't an error
+static void rom_symbol_cache_save(const struct stat *fns_stat)
+{
+	struct rom_symbol_cache_header header;
+	FILE *cache;
+	int good;
+
+	if(!rom_symbol_cache_header(&header, fns_stat))
+		return;
+
+	sprintf(_buffer, "%s" EXT_SYMBOL_CACHE, NoDice_config.filebase);
+	if( (cache = fopen(_buffer, "wb")) == NULL)
+		return;
+	header.label_count = ROM_label_count;
+	header.hash_size = ROM_label_hash_size;
+
+	good =
+		fwrite(&header, sizeof(header), 1, cache) == 1 &&
+		fwrite(ROM_labels, sizeof(struct ROM_label), ROM_label_count, cache) == (size_t)ROM_label_count &&
+		fwrite(ROM_label_hash, sizeof(int), ROM_label_hash_size, cache) == (size_t)ROM_label_hash_size &&
+		fwrite(ROM_labels_by_addr, sizeof(int), ROM_label_count, cache) == (size_t)ROM_label_count;
+
+	if(fclose(cache) != 0)
+		good = 0;
+
+	// Don't leave a partial cache around to be tried next time
+	if(!good)
+		remove(_buffer);
+}
+
+
+// Parses the FNS text into the symbol table
+static int rom_symbols_parse()
+{
+	FILE *rom;
+
+	// Load FNS file
+	sprintf(_buffer, "%s" EXT_SYMBOLS, NoDice_config.filebase);
+	rom = fopen(_buffer, "r");
+
+	if(rom == NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to open binary %s", _buffer);
+		return 0;
+	}
+
+	while(fgets(_buffer, BUFFER_LEN, rom) != NULL)
+	{
+		char label[32];
+		unsigned int addr;
+
+		// Remove any comments
+		char *semi = strchr(_buffer, ';');
+		if(semi != NULL)
+			*semi = '\0';
+
+		// Pull out the label and its assigned address
+		if(sscanf(_buffer, "%31s = $%04X", label, &addr) == 2)
+		{
+			struct ROM_label *label_cur;
+
+			// If sscanf returned 2 fields parsed, we fill in...
+			if(ROM_label_count == ROM_label_alloc)
+			{
+				int alloc = (ROM_label_alloc > 0) ? ROM_label_alloc * 2 : 1024;
+
+				if( (label_cur = (struct ROM_label *)realloc(ROM_labels, alloc * sizeof(struct ROM_label))) == NULL)
+				{
+					snprintf(_error_msg, ERROR_MSG_LEN, "Failed to allocate symbol table");
+					fclose(rom);
+					rom_labels_free();
+					return 0;
+				}
+
+				ROM_labels = label_cur;
+				ROM_label_alloc = alloc;
+			}
+
+			// Copy in the label data (zeroed out so the cache is repeatable)
+			label_cur = &ROM_labels[ROM_label_count++];
+			memset(label_cur, 0, sizeof(struct ROM_label));
+			strcpy(label_cur->label, label);
+			label_cur->address = (unsigned short)addr;
+		}
+	}
+
+	fclose(rom);
+
+	return rom_labels_index();
+}
+
+
+// Loads the symbols, from the cache if use_cache is set and it's good
+// for the FNS (otherwise the FNS is parsed and the cache rebuilt)
+static int _rom_load_symbols(int use_cache)
+{
+	struct stat fns_stat;
+	int have_stat;
+	clock_t start = clock();
+
+	// Free old symbols, if any
+	rom_labels_free();
+
+	sprintf(_buffer, "%s" EXT_SYMBOLS, NoDice_config.filebase);
+	have_stat = (stat(_buffer, &fns_stat) == 0);
+
+	if(have_stat && use_cache && rom_symbol_cache_load(&fns_stat))
+	{
+		rom_symbol_stats.from_cache = 1;
+		rom_symbol_stats.cache_ms = (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+	}
+	else
+	{
+		if(!rom_symbols_parse())
+			return 0;
+
+		if(have_stat)
+			rom_symbol_cache_save(&fns_stat);
+
+		rom_symbol_stats.from_cache = 0;
+		rom_symbol_stats.parse_ms = (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+	}
+
+	rom_symbol_stats.label_count = ROM_label_count;
+
+	return rom_label_handles_resolve();
+}
+
+
+// Reloads the symbols (and everything resolved from them); if
+// use_cache is 0, the FNS is parsed even if the cache is good
+int NoDice_reload_symbols(int use_cache)
+{
+	if(!_rom_load_symbols(use_cache))
+		return 0;
+
+	return _ram_resolve_labels();
+}
+
+
+// Gets how the symbols were last loaded and how long it took
+void NoDice_symbol_stats(struct NoDice_symbol_stats *stats)
+{
+	*stats = rom_symbol_stats;
+}
+
+
+int NoDice_chr_test(struct NoDice_chr_test *test)
+{
+	return _chr_test(_CHR, (int)CHR_banks * 64, test);
+}
+
+
+static void rom_CHR_cache_clear()
+{
+	int i;
+
+	for(i = 0; i < CHR_CACHE_ENTRIES; i++)
+		_CHR_cache[i].bank = -1;
+}
+
+
+static unsigned int rom_PRG_bank_hash(const unsigned char *bank)
+{
+	unsigned int hash = 2166136261u;
+	int i;
+
+	for(i = 0; i < MMC3_BANKSIZE; i++)
+		hash = (hash ^ bank[i]) * 16777619u;
+
+	return hash;
+}
+
+
+int _rom_load()
+{
+	FILE *rom;
+	int i;
+
+	// Load NES file
+	sprintf(_buffer, "%s" EXT_ROM, NoDice_config.filebase);
+	rom = fopen(_buffer, "rb");
+
+	if(rom == NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to open binary %s", _buffer);
+		return 0;
+	}
+
+	// Check for iNES header
+	fread(_buffer, sizeof(char), 4, rom);
+	if(strncmp(_buffer, "NES\x1A", 4))
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "%s" EXT_ROM " does not have a valid iNES header", NoDice_config.filebase);
+		return 0;
+	}
+
+	// Get number of 16KB PRG pages and multiply to get PRG size
+	PRG_size = fgetc(rom) * 16384;
+
+	// Get number of 8KB CHR pages and multiply to find number of 1KB CHR banks (MMC3 standard)
+	CHR_banks = fgetc(rom) * 8;	// because 8KB of CHR means 8 MMC3 CHR banks
+
+	// Skip rest of iNES header
+	fseek(rom, 10, SEEK_CUR);
+
+	// Allocate and read
+	_PRG = (rom_t)malloc(PRG_size);
+	fread((void *)_PRG, sizeof(char), PRG_size, rom);
+
+	for(i = 0; i < PRG_size / MMC3_BANKSIZE; i++)
+	{
+		_PRG_banks[i].hash = rom_PRG_bank_hash(&_PRG[i * MMC3_BANKSIZE]);
+		_PRG_banks[i].serial = rom_PRG_serial;
+		_PRG_banks[i].changed = 0;
+		_PRG_banks[i].free_space = -1;
+	}
+
+#ifdef DECODE6502
+	if(!rom_decode_PRG())
+	{
+		fclose(rom);
+		return 0;
+	}
+#endif
+
+
+	// CHR is kept as is and decoded as banks are asked for
+	{
+		unsigned char *CHR = (unsigned char *)malloc(CHR_banks > 0 ? (int)CHR_banks * 1024 : 1);
+
+		if(CHR == NULL)
+		{
+			snprintf(_error_msg, ERROR_MSG_LEN, "Failed to allocate CHR");
+			fclose(rom);
+			return 0;
+		}
+
+		fread(CHR, sizeof(char), (int)CHR_banks * 1024, rom);
+
+		// Couldn't assign the items under the readonly _CHR after all...
+		_CHR = CHR;
+		rom_CHR_cache_clear();
+	}
+
+	// Close ROM
+	fclose(rom);
+
+	// Reset and prepare the default context for new execution
+	rom_context_init(&rom_default_context, &NoDice_the_level, &NoDice_Run6502_Stop);
+
+	// Load symbols
+	if(!_rom_load_symbols(1))
+		return 0;
+
+	// Resolve RAM labels
+	if(!_ram_resolve_labels())
+		return 0;
+
+	return 1;
+}
+
+void _rom_shutdown()
+{
+	if(_PRG != NULL)
+	{
+		free((void *)_PRG);
+		_PRG = NULL;
+	}
+
+#ifdef DECODE6502
+	free(_PRG_decoded);
+	_PRG_decoded = NULL;
+#endif
+
+	if(_CHR != NULL)
+	{
+		free((void *)_CHR);
+		_CHR = NULL;
+	}
+
+	rom_CHR_cache_clear();
+
+	_banks_free();
+
+	rom_fast_patches_free();
+	NoDice_context_destroy(rom_fast_apply_context);
+	rom_fast_apply_context = NULL;
+
+	rom_labels_free();
+
+	free(ROM_label_handles);
+	ROM_label_handles = NULL;
+	ROM_label_handle_count = 0;
+	rom_label_handles_ready = 0;
+
+	free(rom_default_context.checkpoints);
+	rom_default_context.checkpoints = NULL;
+	rom_default_context.checkpoint_alloc = 0;
+	rom_checkpoints_clear(&rom_default_context);
+	rom_replay_flush(&rom_default_context);
+}
+
+
+// Throws out what was built from a PRG bank whose contents just
+// changed (rom_PRG_serial must already have been bumped for it)
+static void rom_PRG_bank_update(int bank)
+{
+	_PRG_banks[bank].hash = rom_PRG_bank_hash(&_PRG[bank * MMC3_BANKSIZE]);
+	_PRG_banks[bank].serial = rom_PRG_serial;
+	_PRG_banks[bank].free_space = -1;
+
+#ifdef DECODE6502
+	rom_decode_PRG_bank(bank);
+#endif
+}
+
+
+// Fills in a patch of size bytes at offset into the bank; returns 0 if
+// that doesn't fit in the bank.  data is not copied until kept.
+static int rom_fast_patch_make(struct rom_fast_patch *patch, int bank, int offset, const unsigned char *data, int size)
+{
+	if(bank < 0 || bank >= PRG_size / MMC3_BANKSIZE || offset < 0 || offset + size > MMC3_BANKSIZE)
+		return 0;
+
+	patch->offset = bank * MMC3_BANKSIZE + offset;
+	patch->size = size;
+	patch->data = (unsigned char *)data;
+
+	return 1;
+}
+
+
+// Keeps a copy of an applied patch for checking against the next build;
+// it replaces any earlier patch of the same data
+static int rom_fast_patch_keep(const struct rom_fast_patch *patch)
+{
+	struct rom_fast_patch *kept;
+	int i;
+
+	for(i = 0; i < rom_fast_patch_count; i++)
+	{
+		if(rom_fast_patches[i].offset == patch->offset)
+			break;
+	}
+
+	if(i == rom_fast_patch_count)
+	{
+		if( (kept = (struct rom_fast_patch *)realloc(rom_fast_patches, (rom_fast_patch_count + 1) * sizeof(struct rom_fast_patch))) == NULL)
+			return 0;
+
+		rom_fast_patches = kept;
+		rom_fast_patch_count++;
+	}
+	else
+		free(rom_fast_patches[i].data);
+
+	kept = &rom_fast_patches[i];
+	kept->offset = patch->offset;
+	kept->size = patch->size;
+
+	if( (kept->data = (unsigned char *)malloc(patch->size)) == NULL)
+	{
+		// Leave it out rather than keep a patch with no data
+		*kept = rom_fast_patches[--rom_fast_patch_count];
+		return 0;
+	}
+
+	memcpy(kept->data, patch->data, patch->size);
+
+	return 1;
+}
+
+
+static void rom_fast_patches_free()
+{
+	int i;
+
+	for(i = 0; i < rom_fast_patch_count; i++)
+		free(rom_fast_patches[i].data);
+
+	free(rom_fast_patches);
+	rom_fast_patches = NULL;
+	rom_fast_patch_count = 0;
+}
+
+
+// Checks the patches from NoDice_fast_apply_level against a freshly
+// assembled PRG, then drops them; returns the label of the first one
+// which didn't come out the same (NULL if all did)
+static const char *rom_fast_patches_check(const unsigned char *PRG)
+{
+	static char mismatch[64];
+	int i, found = 0;
+
+	for(i = 0; i < rom_fast_patch_count; i++)
+	{
+		const struct rom_fast_patch *patch = &rom_fast_patches[i];
+		const char *label;
+
+		if(!found && memcmp(&PRG[patch->offset], patch->data, patch->size))
+		{
+			label = _rom_label_nearest((unsigned short)((patch->offset / MMC3_BANKSIZE == OBJ_BANK ? PRG_C_START : PRG_B_START) + patch->offset % MMC3_BANKSIZE));
+			snprintf(mismatch, sizeof(mismatch), "%s", (label != NULL) ? label : "?");
+			found = 1;
 		}
 	}
 
-	fclose(rom);
+	rom_fast_patches_free();
 
-	return 1;
+	return found ? mismatch : NULL;
 }
 
 
-int _rom_load()
+int NoDice_PRG_refresh()
 {
+	int PRG_size_check = PRG_size, bank, changed = 0;
+	const char *mismatch;
+	unsigned char *PRG;
 	FILE *rom;
 
 	// Load NES file
@@ -576,192 +2671,279 @@ int _rom_load()
 	// Get number of 16KB PRG pages and multiply to get PRG size
 	PRG_size = fgetc(rom) * 16384;
 
-	// Get number of 8KB CHR pages and multiply to find number of 1KB CHR banks (MMC3 standard)
-	CHR_banks = fgetc(rom) * 8;	// because 8KB of CHR means 8 MMC3 CHR banks
+	// This is unlikely to happen unless you were screwing around...
+	// We don't want to reallocate because it might break current
+	// references in the editor, just reload PRG, so don't screw
+	// with the header right now please!~
+	if(PRG_size != PRG_size_check)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to refresh PRG cache because PRG changed size?!  Recommend shutting down and restarting NoDice if modifying ROM header!");
+		return 0;
+	}
+
+	// This function will not load CHR
+	fgetc(rom);
 
 	// Skip rest of iNES header
 	fseek(rom, 10, SEEK_CUR);
 
-	// Allocate and read
-	_PRG = (rom_t)malloc(PRG_size);
-	fread((void *)_PRG, sizeof(char), PRG_size, rom);
+	// Re-read PRG to the side first; only the banks that differ are
+	// copied over (in place, as contexts point into _PRG) and have
+	// what was built from them thrown out
+	if( (PRG = (unsigned char *)malloc(PRG_size)) == NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to allocate PRG for refresh");
+		fclose(rom);
+		return 0;
+	}
 
+	fread(PRG, sizeof(char), PRG_size, rom);
 
-	// The CHR memory is in a strange planar format unique to the NES.
-	// Each tile is 8x8 pixels at 2bpp depth so:
-	// In total each tile is (8px * 2bpp * 8) = 128 bits / 8 = 16 bytes
-	// We'll decode it to regular 8bpp linear memory for ease of use...
+	// Close ROM
+	fclose(rom);
+
+	for(bank = 0; bank < PRG_size / MMC3_BANKSIZE; bank++)
 	{
-		int tile, row, chrpos = 0;
-		char tile_buffer[16];	// Read in one 8x8 tile for decoding
+		const unsigned char *bank_data = &PRG[bank * MMC3_BANKSIZE];
+		unsigned char *bank_PRG = (unsigned char *)&_PRG[bank * MMC3_BANKSIZE];
 
-		// Allocate enough space to store CHR as 8bpp
-		// In 8bpp, each 8x8 occupies 8 * 8 * 8bpp = 512 bits / 8 = 64 bytes
-		unsigned char *CHR = (unsigned char *)malloc((int)CHR_banks * 64 * 64);
+		// Compared outright, since a hash could miss a change
+		_PRG_banks[bank].changed = memcmp(bank_PRG, bank_data, MMC3_BANKSIZE) != 0;
 
-		// Each bank is 1KB of PPU data, so given that each tile is 16
-		// bytes, each bank holds 1024 / 16 = 64 tiles... so the total
-		// tiles we're going to pull in is 64 * CHR_banks
-		for(tile = 0; tile < 64 * CHR_banks; tile++)
-		{
-			// Read tile in whole
-			fread(tile_buffer, sizeof(char), 16, rom);
+		if(!_PRG_banks[bank].changed)
+			continue;
 
-			// Break down all 8 rows
-			for(row = 0; row < 8; row++)
-			{
-				unsigned char a = tile_buffer[ row ];
-				unsigned char b = tile_buffer[ row + 8];
-
-				CHR[chrpos++] = ((a >> 7) & 1) | ((b >> 6) & 2);
-				CHR[chrpos++] = ((a >> 6) & 1) | ((b >> 5) & 2);
-				CHR[chrpos++] = ((a >> 5) & 1) | ((b >> 4) & 2);
-				CHR[chrpos++] = ((a >> 4) & 1) | ((b >> 3) & 2);
-				CHR[chrpos++] = ((a >> 3) & 1) | ((b >> 2) & 2);
-				CHR[chrpos++] = ((a >> 2) & 1) | ((b >> 1) & 2);
-				CHR[chrpos++] = ((a >> 1) & 1) | ((b     ) & 2);
-				CHR[chrpos++] = ((a     ) & 1) | ((b << 1) & 2);
-			}
-		}
+		// Anything emulated on the old bank is out of date
+		if(!changed)
+			rom_PRG_serial++;
+		changed = 1;
 
-		// Couldn't assign the items under the readonly _CHR after all...
-		_CHR = CHR;
+		memcpy(bank_PRG, bank_data, MMC3_BANKSIZE);
+		rom_PRG_bank_update(bank);
 	}
 
-	// Close ROM
-	fclose(rom);
+	// The occupancy index is rebuilt when next asked for
+	if(changed)
+		_banks_free();
 
-	// Reset and prepare for new execution
-	rom_Reset6502(1);
+	// Whatever was patched in by NoDice_fast_apply_level should have
+	// come out of the assembler the same
+	mismatch = rom_fast_patches_check(PRG);
 
-	// Load symbols
-	if(!_rom_load_symbols())
+	free(PRG);
+
+
+	// Need to reload symbols
+	if(!_rom_load_symbols(1))
 		return 0;
 
 	// Resolve RAM labels
 	if(!_ram_resolve_labels())
 		return 0;
 
+	// The assembled ROM is what's loaded now either way
+	if(mismatch != NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Build does not match the level data patched in for %s; the assembled ROM is now loaded", mismatch);
+		return 0;
+	}
+
 	return 1;
 }
 
-void _rom_shutdown()
+
+// Patches the loaded level (the default context's) straight into PRG
+// and the ROM file at the given level's labels, skipping the assembler,
+// if its layout and objects pack to the same size as what's there now
+// (the level's .asm files still need to be written.)  The layout is
+// patched if layout is set, the objects if objects is set.  The next
+// NoDice_PRG_refresh checks that the build came out the same.  Returns
+// 1 if patched, otherwise 0 and a full build is needed (NoDice_Error()
+// says why); nothing is changed unless all of it could be.
+int NoDice_fast_apply_level(const struct NoDice_the_levels *level, int layout, int objects)
 {
-	struct ROM_label *label_cur = ROM_labels, *label_next;
+	const struct NoDice_level *rom_level;
+	struct rom_fast_patch patches[2];
+	unsigned char object_data[1 + OBJS_MAX * 3 + 1];
+	unsigned short layout_addr, object_addr = 0xFFFF;
+	int patch_count = 0, changed = 0, bank, size, i;
+	FILE *rom;
 
-	if(_PRG != NULL)
+	if(NoDice_the_level.tileset == NULL || NoDice_the_level.tileset->id == 0)
 	{
-		free((void *)_PRG);
-		_PRG = NULL;
+		snprintf(_error_msg, ERROR_MSG_LEN, "World maps can't be patched in place");
+		return 0;
 	}
 
-	if(_CHR != NULL)
+	// New levels aren't in the ROM until they're assembled
+	if( (layout_addr = NoDice_get_addr_for_label(level->layoutlabel)) == 0xFFFF ||
+		(level->objectlabel != NULL && level->objectlabel[0] != '\0' && (object_addr = NoDice_get_addr_for_label(level->objectlabel)) == 0xFFFF))
 	{
-		free((void *)_CHR);
-		_CHR = NULL;
+		snprintf(_error_msg, ERROR_MSG_LEN, "%s is not in the ROM yet", level->name);
+		return 0;
 	}
 
-	while(label_cur != NULL)
+	// What the ROM has for it now
+	if(rom_fast_apply_context == NULL && (rom_fast_apply_context = NoDice_context_create()) == NULL)
+		return 0;
+
+	NoDice_context_load_level_by_addr(rom_fast_apply_context, NoDice_the_level.tileset->id, layout_addr, object_addr);
+
+	if(NoDice_context_stop_reason(rom_fast_apply_context) != RUN6502_STOP_END)
 	{
-		label_next = label_cur->next;
-		free(label_cur);
-		label_cur = label_next;
+		snprintf(_error_msg, ERROR_MSG_LEN, "%s did not load from the ROM: %s", level->name, NoDice_stop_reason_string(NoDice_context_stop_reason(rom_fast_apply_context)));
+		return 0;
 	}
 
-	ROM_labels = NULL;
-}
+	rom_level = NoDice_context_level(rom_fast_apply_context);
 
+	if(layout)
+	{
+		const unsigned char *level_data = NoDice_pack_level(&size, 1);
 
-int NoDice_PRG_refresh()
-{
-	int PRG_size_check = PRG_size;
-	FILE *rom;
+		if( (bank = NoDice_get_tileset_bank(NoDice_the_level.tileset->id)) < 0 ||
+			size != rom_level->addr_end - rom_level->addr_start + 1 ||
+			!rom_fast_patch_make(&patches[patch_count++], bank, layout_addr - PRG_B_START, level_data, size))
+		{
+			snprintf(_error_msg, ERROR_MSG_LEN, "Level layout changed size");
+			return 0;
+		}
+	}
 
-	// Load NES file
+	if(objects && object_addr != 0xFFFF)
+	{
+		object_data[0] = NoDice_the_level.object_unknown;
+
+		for(i = 0; i < NoDice_the_level.object_count; i++)
+		{
+			object_data[1 + i * 3 + 0] = NoDice_the_level.objects[i].id;
+			object_data[1 + i * 3 + 1] = NoDice_the_level.objects[i].col;
+			object_data[1 + i * 3 + 2] = NoDice_the_level.objects[i].row;
+		}
+
+		object_data[1 + i * 3] = 0xFF;
+
+		if(NoDice_the_level.object_count != rom_level->object_count ||
+			!rom_fast_patch_make(&patches[patch_count++], OBJ_BANK, object_addr - PRG_C_START, object_data, 1 + i * 3 + 1))
+		{
+			snprintf(_error_msg, ERROR_MSG_LEN, "Object count changed");
+			return 0;
+		}
+	}
+
+	// ROM file first, so a failure leaves PRG as it was
 	sprintf(_buffer, "%s" EXT_ROM, NoDice_config.filebase);
-	rom = fopen(_buffer, "rb");
 
-	if(rom == NULL)
+	if( (rom = fopen(_buffer, "r+b")) == NULL)
 	{
 		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to open binary %s", _buffer);
 		return 0;
 	}
 
-	// Check for iNES header
-	fread(_buffer, sizeof(char), 4, rom);
-	if(strncmp(_buffer, "NES\x1A", 4))
+	for(i = 0; i < patch_count; i++)
 	{
-		snprintf(_error_msg, ERROR_MSG_LEN, "%s" EXT_ROM " does not have a valid iNES header", NoDice_config.filebase);
-		return 0;
+		if(fseek(rom, 16 + patches[i].offset, SEEK_SET) != 0 ||
+			fwrite(patches[i].data, 1, patches[i].size, rom) != (size_t)patches[i].size)
+			break;
 	}
 
-	// Get number of 16KB PRG pages and multiply to get PRG size
-	PRG_size = fgetc(rom) * 16384;
-
-	// This is unlikely to happen unless you were screwing around...
-	// We don't want to reallocate because it might break current
-	// references in the editor, just reload PRG, so don't screw
-	// with the header right now please!~
-	if(PRG_size != PRG_size_check)
+	if(fclose(rom) != 0 || i < patch_count)
 	{
-		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to refresh PRG cache because PRG changed size?!  Recommend shutting down and restarting NoDice if modifying ROM header!");
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to write %s; it needs a full build", _buffer);
 		return 0;
 	}
 
-	// This function will not load CHR
-	fgetc(rom);
+	for(i = 0; i < PRG_size / MMC3_BANKSIZE; i++)
+		_PRG_banks[i].changed = 0;
 
-	// Skip rest of iNES header
-	fseek(rom, 10, SEEK_CUR);
+	for(i = 0; i < patch_count; i++)
+	{
+		bank = patches[i].offset / MMC3_BANKSIZE;
 
-	// Re-read PRG
-	fread((void *)_PRG, sizeof(char), PRG_size, rom);
+		// As with a refresh, only a bank that really changed is thrown out
+		if(memcmp(&_PRG[patches[i].offset], patches[i].data, patches[i].size))
+		{
+			if(!changed)
+				rom_PRG_serial++;
+			changed = 1;
 
-	// Close ROM
-	fclose(rom);
+			memcpy((unsigned char *)&_PRG[patches[i].offset], patches[i].data, patches[i].size);
 
+			_PRG_banks[bank].changed = 1;
+			rom_PRG_bank_update(bank);
+		}
 
-	// Need to reload symbols
-	if(!_rom_load_symbols())
-		return 0;
+		if(!rom_fast_patch_keep(&patches[i]))
+		{
+			snprintf(_error_msg, ERROR_MSG_LEN, "Out of memory keeping patch; it needs a full build");
+			return 0;
+		}
+	}
 
-	// Resolve RAM labels
-	if(!_ram_resolve_labels())
-		return 0;
+	if(changed)
+		_banks_free();
 
 	return 1;
 }
 
 
-static const unsigned char *rom_make_ptr_for_addr(unsigned short Addr)
+static const unsigned char *rom_make_ptr_for_addr(struct NoDice_context *ctx, unsigned short Addr)
 {
 	if(Addr >= PRG_A_START && Addr <= PRG_A_END)
-		return &_PRG_A[Addr - PRG_A_START];
+		return &ctx->_PRG_A[Addr - PRG_A_START];
 	else if(Addr >= PRG_B_START && Addr <= PRG_B_END)
-		return &_PRG_B[Addr - PRG_B_START];
+		return &ctx->_PRG_B[Addr - PRG_B_START];
 	else if(Addr >= PRG_C_START && Addr <= PRG_C_END)
-		return &_PRG_C[Addr - PRG_C_START];
+		return &ctx->_PRG_C[Addr - PRG_C_START];
 	else if(Addr >= PRG_D_START && Addr <= PRG_D_END)
-		return &_PRG_D[Addr - PRG_D_START];
+		return &ctx->_PRG_D[Addr - PRG_D_START];
 
 	return NULL;
 }
 
 
-unsigned short NoDice_get_addr_for_label(const char *label)
+int _rom_PRG_size()
+{
+	return PRG_size;
+}
+
+
+// Returns the label at or closest below addr, or NULL if there isn't one
+const char *_rom_label_nearest(unsigned short addr)
 {
-	// FIXME: This should be redone as a sorted array so we can implement a binary search!!
+	int low = 0, high = ROM_label_count, address;
 
-	struct ROM_label *label_cur = ROM_labels;
-	while(label_cur != NULL)
+	// Find the first label past addr...
+	while(low < high)
 	{
-		// If label found, return address
-		if(!strcmp(label_cur->label, label))
-			return label_cur->address;
+		int mid = (low + high) / 2;
 
-		label_cur = label_cur->next;
+		if(ROM_labels[ROM_labels_by_addr[mid]].address <= addr)
+			low = mid + 1;
+		else
+			high = mid;
 	}
 
+	if(low == 0)
+		return NULL;
+
+	// ... and the first label in the FNS at the address before it
+	address = ROM_labels[ROM_labels_by_addr[--low]].address;
+	while(low > 0 && ROM_labels[ROM_labels_by_addr[low - 1]].address == address)
+		low--;
+
+	return ROM_labels[ROM_labels_by_addr[low]].label;
+}
+
+
+unsigned short NoDice_get_addr_for_label(const char *label)
+{
+	int index = rom_label_find(label);
+
+	// If label found, return address
+	if(index >= 0)
+		return ROM_labels[index].address;
+
 	snprintf(_error_msg, ERROR_MSG_LEN, "Failed to find label \"%s\" in FNS listing", label);
 
 	// Label not found
@@ -769,6 +2951,80 @@ unsigned short NoDice_get_addr_for_label(const char *label)
 }
 
 
+// Returns the (first) label at exactly addr, or NULL if there isn't one
+const char *NoDice_get_label_for_addr(unsigned short addr)
+{
+	const char *label = _rom_label_nearest(addr);
+
+	return (label != NULL && NoDice_get_addr_for_label(label) == addr) ? label : NULL;
+}
+
+
+// Returns a handle for the label, whose address is looked up whenever
+// the symbols are loaded rather than on every use; getting the same
+// label again returns the same handle.  The label need not exist (yet.)
+// Not thread safe; get handles before sharing the ROM between threads.
+// Returns -1 if out of memory.
+NoDice_label_handle NoDice_get_label_handle(const char *label)
+{
+	struct ROM_label_handle *handle;
+	int i, index;
+
+	for(i = 0; i < ROM_label_handle_count; i++)
+	{
+		if(!strcmp(ROM_label_handles[i].label, label))
+			return i;
+	}
+
+	if( (handle = (struct ROM_label_handle *)realloc(ROM_label_handles, (ROM_label_handle_count + 1) * sizeof(struct ROM_label_handle))) == NULL)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to allocate label handle");
+		return -1;
+	}
+
+	ROM_label_handles = handle;
+	handle = &ROM_label_handles[ROM_label_handle_count];
+
+	strncpy(handle->label, label, sizeof(handle->label) - 1);
+	handle->label[sizeof(handle->label) - 1] = '\0';
+
+	index = rom_label_find(handle->label);
+	handle->address = (index >= 0) ? ROM_labels[index].address : 0xFFFF;
+
+	return ROM_label_handle_count++;
+}
+
+
+// Same as NoDice_get_addr_for_label, by handle
+unsigned short NoDice_get_addr_for_handle(NoDice_label_handle handle)
+{
+	if(handle < 0 || handle >= ROM_label_handle_count)
+	{
+		snprintf(_error_msg, ERROR_MSG_LEN, "Invalid label handle %i", handle);
+		return 0xFFFF;
+	}
+
+	if(ROM_label_handles[handle].address == 0xFFFF)
+		snprintf(_error_msg, ERROR_MSG_LEN, "Failed to find label \"%s\" in FNS listing", ROM_label_handles[handle].label);
+
+	return ROM_label_handles[handle].address;
+}
+
+
+// Address of one of the per-world labels for world (0-based)
+static unsigned short rom_world_label_addr(int world, enum ROM_WORLD_LABELS which)
+{
+	char label[32];
+
+	if(world < ROM_WORLDS)
+		return NoDice_get_addr_for_handle(rom_world_labels[world][which]);
+
+	snprintf(label, sizeof(label), rom_world_label_formats[which], world + 1);
+	return NoDice_get_addr_for_label(label);
+}
+
+
+// Sets the pages on the currently running context (rom_ctx)
 static void rom_MMC3_set_pages(unsigned char page_A000, unsigned char page_C000)
 {
 	Wr6502(_ram[MMC3PAGE_A000].address, page_A000);
@@ -783,7 +3039,7 @@ static void rom_MMC3_set_pages(unsigned char page_A000, unsigned char page_C000)
 }
 
 
-void NoDice_load_level(unsigned char tileset, const char *level_layout, const char *object_layout)
+void NoDice_context_load_level(struct NoDice_context *ctx, unsigned char tileset, const char *level_layout, const char *object_layout)
 {
 	unsigned short address, object_address;
 
@@ -791,13 +3047,13 @@ void NoDice_load_level(unsigned char tileset, const char *level_layout, const ch
 	{
 		if( (address = NoDice_get_addr_for_label(level_layout)) == 0xFFFF)
 		{
-			NoDice_Run6502_Stop = RUN6502_INIT_ERROR;
+			*ctx->stop = RUN6502_INIT_ERROR;
 			return;
 		}
 
 		if( (object_address = NoDice_get_addr_for_label(object_layout)) == 0xFFFF)
 		{
-			NoDice_Run6502_Stop = RUN6502_INIT_ERROR;
+			*ctx->stop = RUN6502_INIT_ERROR;
 			return;
 		}
 	}
@@ -808,11 +3064,19 @@ void NoDice_load_level(unsigned char tileset, const char *level_layout, const ch
 		object_address = 0;
 	}
 
-	NoDice_load_level_by_addr(tileset, address, object_address);
+	NoDice_context_load_level_by_addr(ctx, tileset, address, object_address);
 }
 
 
-void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, unsigned short object_address)
+void NoDice_load_level(unsigned char tileset, const char *level_layout, const char *object_layout)
+{
+	NoDice_context_load_level(&rom_default_context, tileset, level_layout, object_layout);
+}
+
+
+// Loads a level; if resume is set, the generators are picked up from
+// that checkpoint (if possible) rather than from the beginning
+static void rom_load_level(struct NoDice_context *ctx, unsigned char tileset, unsigned short address, unsigned short object_address, const struct rom_checkpoint *resume)
 {
 	// The setup for loading a level layout looks like this:
 
@@ -830,115 +3094,140 @@ void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, un
 		Level_BG_Pages1, Level_BG_Pages2, TileLayout_ByTileset,
 		Palette_By_Tileset;
 
+	struct NoDice_level *level = ctx->level;
 	unsigned short header_addr;
 	int i;
 
+	// The 6502 runs on this context now
+	rom_ctx = ctx;
+
+	// Recorded generators are only good for the PRG they ran on
+	if(ctx->replay_PRG_serial != rom_PRG_serial)
+	{
+		rom_replay_invalidate(ctx, ctx->replay_PRG_serial);
+		ctx->replay_PRG_serial = rom_PRG_serial;
+	}
+
 	// Resolve labels
-	if( (PAGE_A000_ByTileset = NoDice_get_addr_for_label("PAGE_A000_ByTileset")) == 0xFFFF)
+	if( (PAGE_A000_ByTileset = NoDice_get_addr_for_handle(rom_hot_labels[HOT_PAGE_A000_BYTILESET])) == 0xFFFF)
 	{
-		NoDice_Run6502_Stop = RUN6502_INIT_ERROR;
+		*ctx->stop = RUN6502_INIT_ERROR;
 		return;
 	}
 
-	if( (PAGE_C000_ByTileset = NoDice_get_addr_for_label("PAGE_C000_ByTileset")) == 0xFFFF)
+	if( (PAGE_C000_ByTileset = NoDice_get_addr_for_handle(rom_hot_labels[HOT_PAGE_C000_BYTILESET])) == 0xFFFF)
 	{
-		NoDice_Run6502_Stop = RUN6502_INIT_ERROR;
+		*ctx->stop = RUN6502_INIT_ERROR;
 		return;
 	}
 
 
-	if( (Level_BG_Pages1 = NoDice_get_addr_for_label("Level_BG_Pages1")) == 0xFFFF)
+	if( (Level_BG_Pages1 = NoDice_get_addr_for_handle(rom_hot_labels[HOT_LEVEL_BG_PAGES1])) == 0xFFFF)
 	{
-		NoDice_Run6502_Stop = RUN6502_INIT_ERROR;
+		*ctx->stop = RUN6502_INIT_ERROR;
 		return;
 	}
 
-	if( (Level_BG_Pages2 = NoDice_get_addr_for_label("Level_BG_Pages2")) == 0xFFFF)
+	if( (Level_BG_Pages2 = NoDice_get_addr_for_handle(rom_hot_labels[HOT_LEVEL_BG_PAGES2])) == 0xFFFF)
 	{
-		NoDice_Run6502_Stop = RUN6502_INIT_ERROR;
+		*ctx->stop = RUN6502_INIT_ERROR;
 		return;
 	}
 
-	if( (TileLayout_ByTileset = NoDice_get_addr_for_label("TileLayout_ByTileset")) == 0xFFFF)
+	if( (TileLayout_ByTileset = NoDice_get_addr_for_handle(rom_hot_labels[HOT_TILELAYOUT_BYTILESET])) == 0xFFFF)
 	{
-		NoDice_Run6502_Stop = RUN6502_INIT_ERROR;
+		*ctx->stop = RUN6502_INIT_ERROR;
 		return;
 	}
 
-	if( (Palette_By_Tileset = NoDice_get_addr_for_label("Palette_By_Tileset")) == 0xFFFF)
+	if( (Palette_By_Tileset = NoDice_get_addr_for_handle(rom_hot_labels[HOT_PALETTE_BY_TILESET])) == 0xFFFF)
 	{
-		NoDice_Run6502_Stop = RUN6502_INIT_ERROR;
+		*ctx->stop = RUN6502_INIT_ERROR;
 		return;
 	}
 
 
 	if(tileset > 0)
 	{
-		if( (LevelLoad_ByTileset = NoDice_get_addr_for_label("LevelLoad_ByTileset")) == 0xFFFF)
+		if( (LevelLoad_ByTileset = NoDice_get_addr_for_handle(rom_hot_labels[HOT_LEVELLOAD_BYTILESET])) == 0xFFFF)
 		{
-			NoDice_Run6502_Stop = RUN6502_INIT_ERROR;
+			*ctx->stop = RUN6502_INIT_ERROR;
 			return;
 		}
 
-		if( (LoadLevel_StoreJctStart = NoDice_get_addr_for_label("LoadLevel_StoreJctStart")) == 0xFFFF)
+		if( (ctx->LoadLevel_StoreJctStart = NoDice_get_addr_for_handle(rom_hot_labels[HOT_LOADLEVEL_STOREJCTSTART])) == 0xFFFF)
 		{
-			NoDice_Run6502_Stop = RUN6502_INIT_ERROR;
+			*ctx->stop = RUN6502_INIT_ERROR;
 			return;
 		}
 
-		if( (LeveLoad_Generators = NoDice_get_addr_for_label("LeveLoad_Generators")) == 0xFFFF)
+		if( (ctx->LeveLoad_Generators = NoDice_get_addr_for_handle(rom_hot_labels[HOT_LEVELOAD_GENERATORS])) == 0xFFFF)
 		{
-			NoDice_Run6502_Stop = RUN6502_INIT_ERROR;
+			*ctx->stop = RUN6502_INIT_ERROR;
 			return;
 		}
 
-		if( (LeveLoad_FixedSizeGens = NoDice_get_addr_for_label("LeveLoad_FixedSizeGens")) == 0xFFFF)
+		if( (ctx->LeveLoad_FixedSizeGens = NoDice_get_addr_for_handle(rom_hot_labels[HOT_LEVELOAD_FIXEDSIZEGENS])) == 0xFFFF)
 		{
-			NoDice_Run6502_Stop = RUN6502_INIT_ERROR;
+			*ctx->stop = RUN6502_INIT_ERROR;
 			return;
 		}
 
 
-		// Reset and prepare for new execution (best to start clean!)
-		rom_Reset6502(1);
+		// Pick up where the checkpoint left off (the header and
+		// everything before it is unchanged) or start over
+		if(resume == NULL || !rom_checkpoint_restore(ctx, resume))
+		{
+			ctx->checkpoint_count = 0;
+			memset(ctx->checkpoint_banks, 0, sizeof(ctx->checkpoint_banks));
 
-		// We ARE loading a level!
-		is_loading_level = 1;
+			// Reset and prepare for new execution (best to start clean!)
+			rom_Reset6502(ctx, 1);
 
-		// If loaded a level previously, free the level generator lists
-		_rom_free_level_list();
+			// We ARE loading a level!
+			rom_set_loading_level(ctx, 1);
 
-		// Configure for level load
-		Wr6502(_ram[LEVEL_LAYPTR_ADDRL].address, LOW(address));
-		Wr6502(_ram[LEVEL_LAYPTR_ADDRH].address, HIGH(address));
-		Wr6502(_ram[LEVEL_TILESET].address, tileset);
+			// If loaded a level previously, free the level generator lists
+			rom_free_level_list(ctx);
 
-		// Set up the pages and call an imitation of PRGROM_Change_Both2
-		rom_MMC3_set_pages(Rd6502(PAGE_A000_ByTileset + Level_Tileset), Rd6502(PAGE_C000_ByTileset + Level_Tileset));
+			// Tiles no generator writes don't belong to any
+			memset(level->tile_id_grid, 0, sizeof(level->tile_id_grid));
 
-		// Before we run the emulation, let's capture header data...
-		header_addr = MAKE16(Level_LayPtr_AddrH, Level_LayPtr_AddrL);
-		NoDice_the_level.header.alt_level_layout =
-				MAKE16(Rd6502(header_addr+1), Rd6502(header_addr+0));
-		NoDice_the_level.header.alt_level_objects =
-				MAKE16(Rd6502(header_addr+3), Rd6502(header_addr+2));
+			// Configure for level load
+			Wr6502(_ram[LEVEL_LAYPTR_ADDRL].address, LOW(address));
+			Wr6502(_ram[LEVEL_LAYPTR_ADDRH].address, HIGH(address));
+			Wr6502(_ram[LEVEL_TILESET].address, tileset);
 
-		for(i = 0; i < LEVEL_HEADER_COUNT; i++)
-			NoDice_the_level.header.option[i] = Rd6502(header_addr+4+i);
+			// Set up the pages and call an imitation of PRGROM_Change_Both2
+			rom_MMC3_set_pages(Rd6502(PAGE_A000_ByTileset + Level_Tileset), Rd6502(PAGE_C000_ByTileset + Level_Tileset));
 
-		// Set all jct starts to 0xFF
-		for(i = 0; i < LEVEL_JCT_STARTS; i++)
-		{
-			NoDice_the_level.Level_JctXLHStart[i] = 0xFF;
-			NoDice_the_level.Level_JctYLHStart[i] = 0xFF;
+			// Before we run the emulation, let's capture header data...
+			header_addr = MAKE16(Level_LayPtr_AddrH, Level_LayPtr_AddrL);
+			level->header.alt_level_layout =
+					MAKE16(Rd6502(header_addr+1), Rd6502(header_addr+0));
+			level->header.alt_level_objects =
+					MAKE16(Rd6502(header_addr+3), Rd6502(header_addr+2));
+
+			for(i = 0; i < LEVEL_HEADER_COUNT; i++)
+				level->header.option[i] = Rd6502(header_addr+4+i);
+
+			// Set all jct starts to 0xFF
+			for(i = 0; i < LEVEL_JCT_STARTS; i++)
+			{
+				level->Level_JctXLHStart[i] = 0xFF;
+				level->Level_JctYLHStart[i] = 0xFF;
+			}
+
+			// Force PC to the LevelLoad_ByTileset subroutine
+			ctx->CPU_Context.PC.W = LevelLoad_ByTileset;
 		}
 
-		// Force PC to the LevelLoad_ByTileset subroutine
-		CPU_Context.PC.W = LevelLoad_ByTileset;
-		Run6502(&CPU_Context);
+		// Run6502 always runs at least one instruction
+		if(*ctx->stop == RUN6502_STOP_NOTSTOPPED)
+			Run6502(&ctx->CPU_Context);
 
 		// The last generator doesn't get a chance to be patched, so we'll do it now
-		prev_gen_patch(0);
+		prev_gen_patch(ctx, 0);
 	}
 	else
 	{
@@ -946,20 +3235,23 @@ void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, un
 
 		// World Map only (Tileset 0)
 		// Loads the grid tiles
-		if( (Map_Reload_with_Completions = NoDice_get_addr_for_label("Map_Reload_with_Completions")) == 0xFFFF)
+		if( (Map_Reload_with_Completions = NoDice_get_addr_for_handle(rom_hot_labels[HOT_MAP_RELOAD_WITH_COMPLETIONS])) == 0xFFFF)
 		{
-			NoDice_Run6502_Stop = RUN6502_INIT_ERROR;
+			*ctx->stop = RUN6502_INIT_ERROR;
 			return;
 		}
 
-		if( (Map_Init = NoDice_get_addr_for_label("Map_Init")) == 0xFFFF)
+		if( (Map_Init = NoDice_get_addr_for_handle(rom_hot_labels[HOT_MAP_INIT])) == 0xFFFF)
 		{
-			NoDice_Run6502_Stop = RUN6502_INIT_ERROR;
+			*ctx->stop = RUN6502_INIT_ERROR;
 			return;
 		}
 
 		// Not considered a "level" (i.e. no generators)
-		is_loading_level = 0;
+		rom_set_loading_level(ctx, 0);
+
+		// ... so no tiles belong to one
+		memset(level->tile_id_grid, 0, sizeof(level->tile_id_grid));
 
 
 		/////////////////////////////////////////////////////////////////////
@@ -967,7 +3259,7 @@ void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, un
 		/////////////////////////////////////////////////////////////////////
 
 		// Reset and prepare for new execution (best to start clean!)
-		rom_Reset6502(1);
+		rom_Reset6502(ctx, 1);
 
 		// World_Num is the value held in "address"
 		Wr6502(_ram[WORLD_NUM].address, (unsigned char)address);
@@ -976,8 +3268,8 @@ void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, un
 		rom_MMC3_set_pages(Rd6502(PAGE_A000_ByTileset + Level_Tileset), Rd6502(PAGE_C000_ByTileset + Level_Tileset));
 
 		// Force PC to the Map_Reload_with_Completions subroutine
-		CPU_Context.PC.W = Map_Init;
-		Run6502(&CPU_Context);
+		ctx->CPU_Context.PC.W = Map_Init;
+		Run6502(&ctx->CPU_Context);
 
 
 		/////////////////////////////////////////////////////////////////////
@@ -985,14 +3277,14 @@ void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, un
 		/////////////////////////////////////////////////////////////////////
 
 		// Reset and prepare for new execution (best to start clean!)
-		rom_Reset6502(0);
+		rom_Reset6502(ctx, 0);
 
 		// Set up the pages and call an imitation of PRGROM_Change_Both2
 		rom_MMC3_set_pages(MAP_LAYOUT_BANK, PAGE_C000);	// FIXME: Hardcoded
 
 		// Force PC to the Map_Reload_with_Completions subroutine
-		CPU_Context.PC.W = Map_Reload_with_Completions;
-		Run6502(&CPU_Context);
+		ctx->CPU_Context.PC.W = Map_Reload_with_Completions;
+		Run6502(&ctx->CPU_Context);
 
 	}
 
@@ -1007,7 +3299,7 @@ void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, un
 		{
 			if(NoDice_config.game.tilesets[i].id == tileset)
 			{
-				NoDice_the_level.tileset = &NoDice_config.game.tilesets[i];
+				level->tileset = &NoDice_config.game.tilesets[i];
 				break;
 			}
 		}
@@ -1016,13 +3308,13 @@ void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, un
 	if(tileset > 0)
 	{
 		// Regular level has lots of info
-		NoDice_the_level.header.alt_level_tileset = Level_AltTileset;
-		NoDice_the_level.header.is_vert = Level_7Vertical;
-		NoDice_the_level.header.total_screens = Level_Width + 1;
-		NoDice_the_level.header.vert_scroll = (!NoDice_the_level.header.is_vert) ?
+		level->header.alt_level_tileset = Level_AltTileset;
+		level->header.is_vert = Level_7Vertical;
+		level->header.total_screens = Level_Width + 1;
+		level->header.vert_scroll = (!level->header.is_vert) ?
 			Vert_Scroll : (Vert_Scroll_Hi * SCREEN_BYTESIZE_V / SCREEN_WIDTH * TILESIZE);
-		NoDice_the_level.bg_page_1 = Rd6502(Level_BG_Pages1 + Level_BG_Page1_2);
-		NoDice_the_level.bg_page_2 = Rd6502(Level_BG_Pages2 + Level_BG_Page1_2);
+		level->bg_page_1 = Rd6502(Level_BG_Pages1 + Level_BG_Page1_2);
+		level->bg_page_2 = Rd6502(Level_BG_Pages2 + Level_BG_Page1_2);
 	}
 	else
 	{
@@ -1033,13 +3325,10 @@ void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, un
 		// through the (very simple) world map data; it is just
 		// raw terminated by 0xFF...
 
-		// Generate the layout label name
-		snprintf(_buffer, BUFFER_LEN, "W%i_Map_Layout", World_Num+1);
-
-		// Attempt to get the start of map data... if we fail,
-		// we'll just assume 4 screens, but that could be
+		// Attempt to get the start of map data (label Wx_Map_Layout)... if
+		// we fail, we'll just assume 4 screens, but that could be
 		// dangerous to an editor...!!
-		if( (map_data_start = NoDice_get_addr_for_label(_buffer)) != 0xFFFF)
+		if( (map_data_start = rom_world_label_addr(World_Num, WORLD_MAP_LAYOUT)) != 0xFFFF)
 		{
 			int byte_count = 0;
 
@@ -1059,15 +3348,15 @@ void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, un
 			screens = 4;
 
 		// World map has some assumptions
-		NoDice_the_level.header.alt_level_tileset = 0;
-		NoDice_the_level.header.is_vert = 0;
-		NoDice_the_level.header.total_screens = screens;
-		NoDice_the_level.header.vert_scroll = Vert_Scroll;
-		NoDice_the_level.bg_page_1 = 20;
-		NoDice_the_level.bg_page_2 = 22;
+		level->header.alt_level_tileset = 0;
+		level->header.is_vert = 0;
+		level->header.total_screens = screens;
+		level->header.vert_scroll = Vert_Scroll;
+		level->bg_page_1 = 20;
+		level->bg_page_2 = 22;
 	}
 
-	NoDice_the_level.tiles = &_RAM[0x6000 - MEM_B_START + MEM_A_END + 1];
+	level->tiles = &ctx->_RAM[0x6000 - MEM_B_START + MEM_A_END + 1];
 
 	// Copy in the four quarters of tiles into the array...
 	{
@@ -1079,7 +3368,7 @@ void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, un
 		{
 			for(tile = 0; tile < 256; tile++)
 				// The layouts are stored as 4 contiguous 256 byte arrays
-				NoDice_the_level.tile_layout[tile][quarter] = Rd6502(layoutAddr++);
+				level->tile_layout[tile][quarter] = Rd6502(layoutAddr++);
 		}
 	}
 
@@ -1095,19 +3384,19 @@ void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, un
 		// Then read colors as offset by PalSel_Tile_Colors
 		int c, base = PalSel_Tile_Colors * 16;
 		for(c = 0; c < 16; c++)
-			NoDice_the_level.bg_pal[c] = Rd6502(pal_base_addr + base + c);
+			level->bg_pal[c] = Rd6502(pal_base_addr + base + c);
 
 		base = PalSel_Obj_Colors * 16;
 		for(c = 0; c < 16; c++)
-			NoDice_the_level.spr_pal[c] = Rd6502(pal_base_addr + base + c);
+			level->spr_pal[c] = Rd6502(pal_base_addr + base + c);
 	}
 
 
 	// Tasks for regular level (not world map) only...
 	if(tileset > 0)
 	{
-		NoDice_the_level.addr_start = address;
-		NoDice_the_level.addr_end = MAKE16(Level_LayPtr_AddrH, Level_LayPtr_AddrL);
+		level->addr_start = address;
+		level->addr_end = MAKE16(Level_LayPtr_AddrH, Level_LayPtr_AddrL);
 
 		/*
 		{
@@ -1115,7 +3404,7 @@ void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, un
 			struct NoDice_the_level_generator *cur;
 			FILE *f = fopen("dump.txt", "w");
 
-			for(cur = NoDice_the_level.generators; cur != NULL; cur = cur->next)
+			for(cur = level->generators; cur != NULL; cur = cur->next)
 			{
 				fprintf(f, "%s\tid = %02i\taddr = %04X/%04X/%04X %i, %i to %i, %i\tsize = %i\tp1 = $%02X\tp2 = $%02X\n", names[cur->type], cur->id, cur->addr_start, cur->addr_min, cur->addr_max, cur->xs, cur->ys, cur->xe, cur->ye, cur->size, cur->p[0], cur->p[1]);
 			}
@@ -1127,18 +3416,18 @@ void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, un
 		// If not the empty object set...
 		if(object_address != 0xFFFF)
 		{
-			is_loading_level = 0;
+			rom_set_loading_level(ctx, 0);
 
 			// Set pages to load object data
 			rom_MMC3_set_pages(PAGE_A000, OBJ_BANK);
 
 			// Grab and hold the mysterious unknown-apparent-no-purpose byte
-			NoDice_the_level.object_unknown = Rd6502(object_address++);
+			level->object_unknown = Rd6502(object_address++);
 
-			NoDice_the_level.object_count = 0;
+			level->object_count = 0;
 			for(i = 0; (i < OBJS_MAX*3) && (Rd6502(object_address + i + 0) != 0xFF); i+=3)
 			{
-				struct NoDice_the_level_object *object = &NoDice_the_level.objects[NoDice_the_level.object_count++];
+				struct NoDice_the_level_object *object = &level->objects[level->object_count++];
 
 				object->id = Rd6502(object_address + i + 0);
 				object->col = Rd6502(object_address + i + 1);
@@ -1153,7 +3442,7 @@ void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, un
 		unsigned short Wx_ByRowType, Wx_ByScrCol, Wx_ObjSets, Wx_LevelLayout;
 
 		// Copy in map objects
-		NoDice_the_level.object_count = 0;
+		level->object_count = 0;
 
 		// Warp Zone bypass does not load objects
 		// FIXME: This check isn't the same as the others (i.e. as string)
@@ -1162,7 +3451,7 @@ void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, un
 			for(i = 0; i < MOBJS_MAX; i++)
 			{
 				unsigned short x = (Map_Objects_XHi(i) << 8) | Map_Objects_XLo(i);
-				struct NoDice_the_level_object *object = &NoDice_the_level.objects[NoDice_the_level.object_count++];
+				struct NoDice_the_level_object *object = &level->objects[level->object_count++];
 
 				// Technically map objects have full pixel placement possibility,
 				// but this is never used, and for now this is more compatible
@@ -1174,7 +3463,7 @@ void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, un
 				//printf("%i %i %i\n", object->id, object->row, object->col);
 
 				// Copy in map object items
-				NoDice_the_level.map_object_items[i] = Map_Objects_Itm(i);
+				level->map_object_items[i] = Map_Objects_Itm(i);
 			}
 		}
 
@@ -1185,44 +3474,40 @@ void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, un
 		// In this case, we'll assume the count comes between the
 		// labels Wx_ByRowType and Wx_ByScrCol
 
-		snprintf(_buffer, BUFFER_LEN, "W%i_ByRowType", World_Num + 1);
-		if( (Wx_ByRowType = NoDice_get_addr_for_label(_buffer)) == 0xFFFF)
+		if( (Wx_ByRowType = rom_world_label_addr(World_Num, WORLD_BYROWTYPE)) == 0xFFFF)
 		{
-			NoDice_Run6502_Stop = RUN6502_INIT_ERROR;
+			*ctx->stop = RUN6502_INIT_ERROR;
 			return;
 		}
 
-		snprintf(_buffer, BUFFER_LEN, "W%i_ByScrCol", World_Num + 1);
-		if( (Wx_ByScrCol = NoDice_get_addr_for_label(_buffer)) == 0xFFFF)
+		if( (Wx_ByScrCol = rom_world_label_addr(World_Num, WORLD_BYSCRCOL)) == 0xFFFF)
 		{
-			NoDice_Run6502_Stop = RUN6502_INIT_ERROR;
+			*ctx->stop = RUN6502_INIT_ERROR;
 			return;
 		}
 
-		snprintf(_buffer, BUFFER_LEN, "W%i_ObjSets", World_Num + 1);
-		if( (Wx_ObjSets = NoDice_get_addr_for_label(_buffer)) == 0xFFFF)
+		if( (Wx_ObjSets = rom_world_label_addr(World_Num, WORLD_OBJSETS)) == 0xFFFF)
 		{
-			NoDice_Run6502_Stop = RUN6502_INIT_ERROR;
+			*ctx->stop = RUN6502_INIT_ERROR;
 			return;
 		}
 
-		snprintf(_buffer, BUFFER_LEN, "W%i_LevelLayout", World_Num + 1);
-		if( (Wx_LevelLayout = NoDice_get_addr_for_label(_buffer)) == 0xFFFF)
+		if( (Wx_LevelLayout = rom_world_label_addr(World_Num, WORLD_LEVELLAYOUT)) == 0xFFFF)
 		{
-			NoDice_Run6502_Stop = RUN6502_INIT_ERROR;
+			*ctx->stop = RUN6502_INIT_ERROR;
 			return;
 		}
 
 		// Get total map links
-		NoDice_the_level.map_link_count = Wx_ByScrCol - Wx_ByRowType;
+		level->map_link_count = Wx_ByScrCol - Wx_ByRowType;
 
 		// Set up the pages and call an imitation of PRGROM_Change_Both2
 		rom_MMC3_set_pages(MAP_LAYOUT_BANK, PAGE_C000);	// FIXME: Hardcoded
 
 		// Read them in...
-		for(i = 0; i < NoDice_the_level.map_link_count; i++)
+		for(i = 0; i < level->map_link_count; i++)
 		{
-			struct NoDice_map_link *link = &NoDice_the_level.map_links[i];
+			struct NoDice_map_link *link = &level->map_links[i];
 
 			// Single byte
 			link->row_tileset = Rd6502(Wx_ByRowType + i);
@@ -1236,11 +3521,26 @@ void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, un
 }
 
 
+void NoDice_context_load_level_by_addr(struct NoDice_context *ctx, unsigned char tileset, unsigned short address, unsigned short object_address)
+{
+	// Not a raw reload, checkpoints won't apply to anything after this
+	rom_checkpoints_clear(ctx);
+
+	rom_load_level(ctx, tileset, address, object_address, NULL);
+}
+
+
+void NoDice_load_level_by_addr(unsigned char tileset, unsigned short address, unsigned short object_address)
+{
+	NoDice_context_load_level_by_addr(&rom_default_context, tileset, address, object_address);
+}
+
+
 // Splits a video address into Temp_Var15/16 components
-static void vaddr_to_level(unsigned short addr, unsigned char *t15, unsigned char *t16)
+static void vaddr_to_level(const struct NoDice_level *level, unsigned short addr, unsigned char *t15, unsigned char *t16)
 {
 	unsigned short inter_screen_offset;
-	int is_vert = NoDice_the_level.header.is_vert;
+	int is_vert = level->header.is_vert;
 
 	// Make "addr" relative
 	addr -= MEM_B_START;
@@ -1267,32 +3567,33 @@ static void vaddr_to_level(unsigned short addr, unsigned char *t15, unsigned cha
 }
 
 
-static void rom_pack_level_header(unsigned char **ptr)
+static void rom_pack_level_header(const struct NoDice_level *level, unsigned char **ptr)
 {
 	int i;
 
 	// Header goes in pretty straight
-	*(*ptr)++ = LOW(NoDice_the_level.header.alt_level_layout);
-	*(*ptr)++ = HIGH(NoDice_the_level.header.alt_level_layout);
-	*(*ptr)++ = LOW(NoDice_the_level.header.alt_level_objects);
-	*(*ptr)++ = HIGH(NoDice_the_level.header.alt_level_objects);
+	*(*ptr)++ = LOW(level->header.alt_level_layout);
+	*(*ptr)++ = HIGH(level->header.alt_level_layout);
+	*(*ptr)++ = LOW(level->header.alt_level_objects);
+	*(*ptr)++ = HIGH(level->header.alt_level_objects);
 
 	for(i = 0; i < LEVEL_HEADER_COUNT; i++)
-		*(*ptr)++ = NoDice_the_level.header.option[i];
+		*(*ptr)++ = level->header.option[i];
 }
 
 
 // Packs level data into raw SMB3 standard form -> _PRG_FakeScratch
-const unsigned char *NoDice_pack_level(int *size, int need_header)
+const unsigned char *NoDice_context_pack_level(struct NoDice_context *ctx, int *size, int need_header)
 {
 	unsigned char t15, t16;
-	struct NoDice_the_level_generator *gen = NoDice_the_level.generators;
-	unsigned char *ptr = _PRG_FakeScratch;
+	const struct NoDice_level *level = ctx->level;
+	struct NoDice_the_level_generator *gen = level->generators;
+	unsigned char *ptr = ctx->_PRG_FakeScratch;
 
 	// If you want the SMB3 engine to load it, you absolutely need the header!
 	// If this is just for the sake of an undo layer, you don't!
 	if(need_header)
-		rom_pack_level_header(&ptr);
+		rom_pack_level_header(level, &ptr);
 
 	// Now to repack the generators...
 	while(gen != NULL)
@@ -1312,15 +3613,15 @@ const unsigned char *NoDice_pack_level(int *size, int need_header)
 			*ptr++ = t15;
 
 			// The junction start itself follows, Y then X
-			*ptr++ = NoDice_the_level.Level_JctYLHStart[gen->id & 0xF];
-			*ptr++ = NoDice_the_level.Level_JctXLHStart[gen->id & 0xF];
+			*ptr++ = level->Level_JctYLHStart[gen->id & 0xF];
+			*ptr++ = level->Level_JctXLHStart[gen->id & 0xF];
 
 			break;
 
 		case GENTYPE_VARIABLE:
 
 			// Decompose address into encoded form
-			vaddr_to_level(gen->addr_start, &t15, &t16);
+			vaddr_to_level(level, gen->addr_start, &t15, &t16);
 
 			// Upper 3 bits of Temp_Var15 select a multiple of 15 for the generator
 			t15 |= ((gen->id / 15) & 0x07) << 5;
@@ -1343,7 +3644,7 @@ const unsigned char *NoDice_pack_level(int *size, int need_header)
 			// abort the execution now...
 			if(gen->size >= 3+GEN_MAX_PARAMS)
 			{
-				NoDice_Run6502_Stop = RUN6502_GENERATOR_TOO_LARGE;
+				*ctx->stop = RUN6502_GENERATOR_TOO_LARGE;
 				break;
 			}
 
@@ -1358,7 +3659,7 @@ const unsigned char *NoDice_pack_level(int *size, int need_header)
 		case GENTYPE_FIXED:
 
 			// Decompose address into encoded form
-			vaddr_to_level(gen->addr_start, &t15, &t16);
+			vaddr_to_level(level, gen->addr_start, &t15, &t16);
 
 			// Upper 3 bits of Temp_Var15 are bits 4-6 of the generator ID
 			t15 |= ((gen->id & 0x70) << 1);
@@ -1384,11 +3685,11 @@ const unsigned char *NoDice_pack_level(int *size, int need_header)
 
 	// Return size, if you want it
 	if(size != NULL)
-		*size = (int)(ptr - _PRG_FakeScratch);
+		*size = (int)(ptr - ctx->_PRG_FakeScratch);
 
 	/*
 	{
-		unsigned char *cur = _PRG_FakeScratch + 9;
+		unsigned char *cur = ctx->_PRG_FakeScratch + 9;
 		int c = 0;
 		FILE *f = fopen("dump.txt", "w");
 
@@ -1411,35 +3712,46 @@ const unsigned char *NoDice_pack_level(int *size, int need_header)
 	}
 	*/
 
-	return _PRG_FakeScratch;
+	return ctx->_PRG_FakeScratch;
+}
+
+
+const unsigned char *NoDice_pack_level(int *size, int need_header)
+{
+	return NoDice_context_pack_level(&rom_default_context, size, need_header);
 }
 
 
 // Reload the level; if undo_data is NULL, it uses current level data,
 // otherwise it loads the feed from "undo_data" plus a header from the
 // currently loaded level; this is mainly for use in an undo system.
-void NoDice_load_level_raw_data(const unsigned char *data, int size, int has_header)
+void NoDice_context_load_level_raw_data(struct NoDice_context *ctx, const unsigned char *data, int size, int has_header)
 {
+	const struct NoDice_level *level = ctx->level;
+	int data_size;
+
 	if(data == NULL)
-		// Pack the level, include the header, don't care about size
-		NoDice_pack_level(NULL, 1);
+		// Pack the level, include the header
+		NoDice_context_pack_level(ctx, &data_size, 1);
 	else
 	{
-		unsigned char *ptr = _PRG_FakeScratch;
+		unsigned char *ptr = ctx->_PRG_FakeScratch;
 
 		// We have raw data...
 
 		// Do we need to supply the header?
 		if(!has_header)
-			rom_pack_level_header(&ptr);
+			rom_pack_level_header(level, &ptr);
 
 		// Push the data in!
 		while(size-- > 0)
 			*ptr++ = *data++;
 
+		data_size = (int)(ptr - ctx->_PRG_FakeScratch);
+
 		/*
 		{
-			unsigned char *cur = _PRG_FakeScratch + 9;
+			unsigned char *cur = ctx->_PRG_FakeScratch + 9;
 			int c = 0;
 			FILE *f = fopen("dump.txt", "w");
 
@@ -1463,38 +3775,116 @@ void NoDice_load_level_raw_data(const unsigned char *data, int size, int has_hea
 		*/
 	}
 
-	// Reload level from scratch area
-	NoDice_load_level_by_addr(NoDice_the_level.tileset->id, SCRATCH_START, 0xFFFF);
+	// Reload level from scratch area; if this is mostly the same data as
+	// last time, the load can resume from the last checkpoint before
+	// the first change instead of starting over
+	ctx->checkpointing = 1;
+	rom_load_level(ctx, level->tileset->id, SCRATCH_START, 0xFFFF, rom_checkpoint_find(ctx, data_size));
+	ctx->checkpointing = 0;
+
+	if(*ctx->stop == RUN6502_STOP_END)
+	{
+		memcpy(ctx->checkpoint_data, ctx->_PRG_FakeScratch, data_size);
+		ctx->checkpoint_data_size = data_size;
+		ctx->checkpoint_tileset = level->tileset->id;
+		ctx->checkpoint_PRG_serial = rom_PRG_serial;
+	}
+	else
+		rom_checkpoints_clear(ctx);
+}
+
+
+void NoDice_load_level_raw_data(const unsigned char *data, int size, int has_header)
+{
+	NoDice_context_load_level_raw_data(&rom_default_context, data, size, has_header);
 }
 
 
+// Returns the bank decoded to 8bpp (64 tiles of 64 bytes each) followed
+// by the bank after it, as MMC3 BG banks are set in pairs.  The data is
+// only good until CHR_CACHE_ENTRIES other banks have been asked for.
 const unsigned char *NoDice_get_raw_CHR_bank(unsigned char bank)
 {
+	struct rom_CHR_cache *entry = &_CHR_cache[0];
+	int i;
+
 	// If you pick an out of range bank, wrap to nearest valid bank
 	if(bank >= CHR_banks)
 		bank %= CHR_banks;
 
-	// Each bank contains 64 tiles, and each tile is 64 bytes in our
-	// decoded form, so return...
-	return &_CHR[(int)bank * 64 * 64];
+	_CHR_cache_clock++;
+
+	for(i = 0; i < CHR_CACHE_ENTRIES; i++)
+	{
+		if(_CHR_cache[i].bank == bank)
+		{
+			_CHR_cache[i].last_used = _CHR_cache_clock;
+			return _CHR_cache[i].data;
+		}
+
+		// Otherwise replace the empty or least recently used entry
+		if(entry->bank >= 0 && (_CHR_cache[i].bank < 0 || _CHR_cache[i].last_used < entry->last_used))
+			entry = &_CHR_cache[i];
+	}
+
+	// The CHR memory is in a strange planar format unique to the NES;
+	// each bank is 1KB of PPU data, 64 tiles of 16 bytes (see chr.c)
+	_chr_decode(&_CHR[(int)bank * 1024], entry->data, 64);
+	_chr_decode(&_CHR[(((int)bank + 1) % CHR_banks) * 1024], entry->data + CHR_BANK_DECODED, 64);
+
+	entry->bank = bank;
+	entry->last_used = _CHR_cache_clock;
+
+	return entry->data;
 }
 
 
-int NoDice_get_tilebank_free_space(unsigned char tileset)
+int NoDice_PRG_bank_count()
+{
+	return PRG_size / MMC3_BANKSIZE;
+}
+
+
+int NoDice_PRG_bank_changed(int bank)
+{
+	return (bank >= 0 && bank < PRG_size / MMC3_BANKSIZE) ? _PRG_banks[bank].changed : 0;
+}
+
+
+unsigned int NoDice_PRG_bank_hash(int bank)
+{
+	return (bank >= 0 && bank < PRG_size / MMC3_BANKSIZE) ? _PRG_banks[bank].hash : 0;
+}
+
+
+int NoDice_get_tileset_bank(unsigned char tileset)
 {
-	unsigned char bank_for_tileset;
 	unsigned short PAGE_A000_ByTileset;
-	static rom_t _PRG_tileset;
+
+	if( (PAGE_A000_ByTileset = NoDice_get_addr_for_handle(rom_hot_labels[HOT_PAGE_A000_BYTILESET])) == 0xFFFF)
+		return -1;
+
+	rom_ctx = &rom_default_context;
+
+	return Rd6502(PAGE_A000_ByTileset + tileset);
+}
+
+
+// Bytes of free space (0xFF) at the end of a PRG bank
+int _rom_PRG_bank_free_space(int bank)
+{
+	rom_t _PRG_bank;
 	int bank_offset;
 
-	// Get bank for tileset
-	if( (PAGE_A000_ByTileset = NoDice_get_addr_for_label("PAGE_A000_ByTileset")) == 0xFFFF)
+	if(bank < 0 || bank >= PRG_size / MMC3_BANKSIZE)
 		return 0;
 
-	bank_for_tileset = Rd6502(PAGE_A000_ByTileset + Level_Tileset);
+	// Good until a refresh changes the bank
+	if(_PRG_banks[bank].free_space >= 0)
+		return _PRG_banks[bank].free_space;
 
-	// Point to end of tileset bank
-	_PRG_tileset = &_PRG[bank_for_tileset * MMC3_BANKSIZE];
+	// Point to end of bank
+	_PRG_bank = &_PRG[bank * MMC3_BANKSIZE];
 
 	// "Free space" in a bank is filled with 0xFFs
 	// End of a level is 0xFF
@@ -1504,7 +3894,7 @@ int NoDice_get_tilebank_free_space(unsigned char tileset)
 	// bytes are "free" in the bank for this tileset...
 	for(bank_offset = MMC3_BANKSIZE-1; bank_offset >= 0; bank_offset--)
 	{
-		if(_PRG_tileset[bank_offset] != 0xFF)
+		if(_PRG_bank[bank_offset] != 0xFF)
 			break;
 	}
 
@@ -1513,7 +3903,19 @@ int NoDice_get_tilebank_free_space(unsigned char tileset)
 	// bank, so really we want to be two steps forward.  One step to get
 	// to the actual last 0xFF and one more to move passed that, assuming
 	// that byte to be the tail end of the last level of the bank.
-	return MMC3_BANKSIZE - (bank_offset + 2);
+	return (_PRG_banks[bank].free_space = MMC3_BANKSIZE - (bank_offset + 2));
+}
+
+
+int NoDice_get_tilebank_free_space(unsigned char tileset)
+{
+	int bank_for_tileset;
+
+	// Get bank for tileset
+	if( (bank_for_tileset = NoDice_get_tileset_bank(tileset)) < 0)
+		return 0;
+
+	return _rom_PRG_bank_free_space(bank_for_tileset);
 }
 
 
@@ -1528,7 +3930,7 @@ const unsigned char *NoDice_get_rest_table()
 	}
 
 	// Get the Music_RestH_LUT assignment out of the way...
-	return rom_make_ptr_for_addr(Music_RestH_LUT);
+	return rom_make_ptr_for_addr(&rom_default_context, Music_RestH_LUT);
 }
 
 
@@ -1548,6 +3950,7 @@ int NoDice_get_music_context(struct NoDice_music_context *context, const char *h
 	// Music_xxx_Headers
 
 	// Music spans page 28 and 29
+	rom_ctx = &rom_default_context;
 	rom_MMC3_set_pages(28, 29);	// FIXME: Hardcoded, should probably allow others
 
 	snprintf(_buffer, BUFFER_LEN, "Music_%s_IndexOffs", header_index_name);
@@ -1615,7 +4018,7 @@ int NoDice_get_music_context(struct NoDice_music_context *context, const char *h
 		// Load segment header data
 		context->rest_table_base = Rd6502(Music_Headers + header_offset + 0);
 
-		this_segment->segment_data = rom_make_ptr_for_addr(
+		this_segment->segment_data = rom_make_ptr_for_addr(&rom_default_context,
 			MAKE16(
 				Rd6502(Music_Headers + header_offset + 2),
 				Rd6502(Music_Headers + header_offset + 1)
@@ -1637,6 +4040,8 @@ void NoDice_tile_test()
 {
 	word i;
 	byte t = 0;
+
+	rom_ctx = &rom_default_context;
 	for(i = MEM_B_START; i < MEM_B_START + 16*16; i++)
 	{
 		Wr6502(i, t++);
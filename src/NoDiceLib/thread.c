@@ -0,0 +1,182 @@
+#include <stdlib.h>
+#include "NoDiceLib.h"
+#include "internal.h"
+
+#ifdef _WIN32
+
+// Win32 threads
+
+#include <windows.h>
+
+struct _thread
+{
+	HANDLE handle;
+	void (*func)(void *);
+	void *arg;
+};
+
+struct _mutex
+{
+	CRITICAL_SECTION cs;
+};
+
+static DWORD WINAPI thread_entry(LPVOID param)
+{
+	struct _thread *thread = (struct _thread *)param;
+
+	thread->func(thread->arg);
+
+	return 0;
+}
+
+_thread_t _thread_create(void (*func)(void *), void *arg)
+{
+	struct _thread *thread = (struct _thread *)malloc(sizeof(struct _thread));
+
+	if(thread == NULL)
+		return NULL;
+
+	thread->func = func;
+	thread->arg = arg;
+
+	if( (thread->handle = CreateThread(NULL, 0, thread_entry, thread, 0, NULL)) == NULL)
+	{
+		free(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+void _thread_join(_thread_t thread)
+{
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+	free(thread);
+}
+
+int _thread_cpu_count()
+{
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+
+	return (info.dwNumberOfProcessors > 0) ? (int)info.dwNumberOfProcessors : 1;
+}
+
+_mutex_t _mutex_create()
+{
+	struct _mutex *mutex = (struct _mutex *)malloc(sizeof(struct _mutex));
+
+	if(mutex != NULL)
+		InitializeCriticalSection(&mutex->cs);
+
+	return mutex;
+}
+
+void _mutex_lock(_mutex_t mutex)
+{
+	EnterCriticalSection(&mutex->cs);
+}
+
+void _mutex_unlock(_mutex_t mutex)
+{
+	LeaveCriticalSection(&mutex->cs);
+}
+
+void _mutex_destroy(_mutex_t mutex)
+{
+	DeleteCriticalSection(&mutex->cs);
+	free(mutex);
+}
+
+#else
+
+// POSIX threads
+
+#include <pthread.h>
+#include <unistd.h>
+
+struct _thread
+{
+	pthread_t handle;
+	void (*func)(void *);
+	void *arg;
+};
+
+struct _mutex
+{
+	pthread_mutex_t m;
+};
+
+static void *thread_entry(void *param)
+{
+	struct _thread *thread = (struct _thread *)param;
+
+	thread->func(thread->arg);
+
+	return NULL;
+}
+
+_thread_t _thread_create(void (*func)(void *), void *arg)
+{
+	struct _thread *thread = (struct _thread *)malloc(sizeof(struct _thread));
+
+	if(thread == NULL)
+		return NULL;
+
+	thread->func = func;
+	thread->arg = arg;
+
+	if(pthread_create(&thread->handle, NULL, thread_entry, thread) != 0)
+	{
+		free(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+void _thread_join(_thread_t thread)
+{
+	pthread_join(thread->handle, NULL);
+	free(thread);
+}
+
+int _thread_cpu_count()
+{
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (count > 0) ? (int)count : 1;
+}
+
+_mutex_t _mutex_create()
+{
+	struct _mutex *mutex = (struct _mutex *)malloc(sizeof(struct _mutex));
+
+	if(mutex != NULL && pthread_mutex_init(&mutex->m, NULL) != 0)
+	{
+		free(mutex);
+		mutex = NULL;
+	}
+
+	return mutex;
+}
+
+void _mutex_lock(_mutex_t mutex)
+{
+	pthread_mutex_lock(&mutex->m);
+}
+
+void _mutex_unlock(_mutex_t mutex)
+{
+	pthread_mutex_unlock(&mutex->m);
+}
+
+void _mutex_destroy(_mutex_t mutex)
+{
+	pthread_mutex_destroy(&mutex->m);
+	free(mutex);
+}
+
+#endif